@@ -1,5 +1,6 @@
 
 
+#include <math.h>
 #include <string.h>
 #include <stdint.h>
 #include <stddef.h>
@@ -7,6 +8,10 @@
 #include "sr.h"
 #include "clip.h"
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 /**
  * sr_clip.c
  * --------
@@ -96,6 +101,63 @@ clip_routine(float* dest, float* src,
     *n_pts = (tmp - dest) / n_attr;    /* new number of points after clip */
 }
 
+/*******************
+ * clip_test_lanes *
+ *******************/
+
+/**
+ * assigns clip flags to eight points laid out as soa lanes,
+ * each plane is one vector compare across all eight points
+ */
+
+static void
+clip_test_lanes(float* x, float* y, float* z, float* w, uint8_t* flags)
+{
+#ifdef __AVX2__
+    __m256 vx = _mm256_loadu_ps(x);
+    __m256 vy = _mm256_loadu_ps(y);
+    __m256 vz = _mm256_loadu_ps(z);
+    __m256 vw = _mm256_loadu_ps(w);
+    __m256 zero = _mm256_setzero_ps();
+
+    __m256 left = _mm256_cmp_ps(_mm256_add_ps(vw, vx), zero, _CMP_LT_OQ);
+    __m256 bottom = _mm256_cmp_ps(_mm256_add_ps(vw, vy), zero, _CMP_LT_OQ);
+    __m256 near = _mm256_cmp_ps(_mm256_add_ps(vw, vz), zero, _CMP_LT_OQ);
+    __m256 right = _mm256_cmp_ps(_mm256_sub_ps(vw, vx), zero, _CMP_LT_OQ);
+    __m256 top = _mm256_cmp_ps(_mm256_sub_ps(vw, vy), zero, _CMP_LT_OQ);
+
+    /* compare masks are all ones, keep only each plane's bit */
+    __m256i codes = _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_and_si256(_mm256_castps_si256(left), 
+                             _mm256_set1_epi32(SR_CLIP_LEFT_PLANE)),
+            _mm256_and_si256(_mm256_castps_si256(bottom), 
+                             _mm256_set1_epi32(SR_CLIP_BOTTOM_PLANE))),
+        _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_and_si256(_mm256_castps_si256(near), 
+                                 _mm256_set1_epi32(SR_CLIP_NEAR_PLANE)),
+                _mm256_and_si256(_mm256_castps_si256(right), 
+                                 _mm256_set1_epi32(SR_CLIP_RIGHT_PLANE))),
+            _mm256_and_si256(_mm256_castps_si256(top), 
+                             _mm256_set1_epi32(SR_CLIP_TOP_PLANE))));
+
+    int32_t tmp[8];
+    _mm256_storeu_si256((__m256i*)tmp, codes);
+    for (int i = 0; i < 8; i++)
+        flags[i] = tmp[i];
+#else
+    /* branchless so the compiler is free to vectorize it */
+    for (int i = 0; i < 8; i++) {
+        flags[i] = ((w[i] + x[i] < 0) << 0) |
+                   ((w[i] + y[i] < 0) << 1) |
+                   ((w[i] + z[i] < 0) << 2) |
+                   ((w[i] - x[i] < 0) << 3) |
+                   ((w[i] - y[i] < 0) << 4);
+    }
+#endif
+}
+
 /*********************************************************************
  *                                                                   *
  *                        public definitions                         *
@@ -149,6 +211,62 @@ clip_poly(float* src, int* n_pts,
     memcpy(src, tmp_src, *n_pts * n_attr * sizeof(float));
 }
 
+/*************
+ * clip_line *
+ *************/
+
+/**
+ * clips a line segment against the planes in 'clip_flags' by 
+ * narrowing its parametric range one plane at a time, leaves
+ * 'n_pts' at 0 if nothing remains, 2 otherwise
+ */
+
+void
+clip_line(float* src, int* n_pts, 
+          int n_attr, uint8_t clip_flags)
+{
+    float* p0 = src;
+    float* p1 = src + n_attr;
+
+    float t0 = 0;    /* visible part of the segment */
+    float t1 = 1;
+
+    /* axis and sign of each plane, in the order of the flag bits */
+    int axes[5] = {0, 1, 2, 0, 1};
+    int signs[5] = {-1, -1, -1, 1, 1};
+
+    for (int i = 0; i < 5; i++) {
+
+        if (!(clip_flags & (1 << i)))
+            continue;
+
+        /* signed distance inside the plane at either end */
+        float d0 = p0[3] - p0[axes[i]] * signs[i];
+        float d1 = p1[3] - p1[axes[i]] * signs[i];
+
+        if (d0 < 0 && d1 < 0) {    /* entirely outside */
+            *n_pts = 0;
+            return;
+        }
+
+        if (d0 < 0)    /* entering */
+            t0 = fmaxf(t0, d0 / (d0 - d1));
+        else if (d1 < 0)    /* leaving */
+            t1 = fminf(t1, d0 / (d0 - d1));
+    }
+
+    if (t0 > t1) {
+        *n_pts = 0;
+        return;
+    }
+
+    float tmp[2 * SR_MAX_ATTRIBUTE_COUNT];
+    lerp(tmp, p0, p1, t0, n_attr);
+    lerp(tmp + n_attr, p0, p1, t1, n_attr);
+    memcpy(src, tmp, 2 * n_attr * sizeof(float));
+    *n_pts = 2;
+}
+
 /*************
  * clip_test *
  *************/
@@ -166,3 +284,42 @@ clip_test(float* pt, uint8_t* flags)
 
     *flags = left | bottom | near | right | top;
 }
+
+/*******************
+ * clip_test_batch *
+ *******************/
+
+/**
+ * assigns clip flags to 'n_pts' points spaced 'stride' floats apart,
+ * transposing them eight at a time into soa lanes for the compares
+ */
+
+void
+clip_test_batch(float* pts, int n_pts, int stride, uint8_t* flags)
+{
+    float x[8], y[8], z[8], w[8];
+    uint8_t tmp[8];
+
+    for (int i = 0; i < n_pts; i += 8) {
+
+        int n = n_pts - i < 8 ? n_pts - i : 8;
+
+        for (int j = 0; j < 8; j++) {
+            if (j < n) {
+                float* pt = pts + (i + j) * stride;
+                x[j] = pt[0];
+                y[j] = pt[1];
+                z[j] = pt[2];
+                w[j] = pt[3];
+            } else {    /* pad the tail with a point inside the frustum */
+                x[j] = 0;
+                y[j] = 0;
+                z[j] = 0;
+                w[j] = 1;
+            }
+        }
+
+        clip_test_lanes(x, y, z, w, tmp);
+        memcpy(flags + i, tmp, n * sizeof(uint8_t));
+    }
+}
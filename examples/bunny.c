@@ -92,6 +92,7 @@ start()
  *********************************************************************/
 
     obj = sr_load_obj("./assets/bunny.obj");
+    sr_optimize_obj(obj);
 
 /*********************************************************************
  *                                                                   *
@@ -100,6 +101,7 @@ start()
  *********************************************************************/
 
     sr_bind_pts(obj->pts, obj->n_pts, obj->n_attr);
+    sr_bind_bounds(obj->bounds);
     sr_bind_framebuffer(SCREEN_WIDTH, SCREEN_HEIGHT, colors, depths);
     sr_bind_std_vs();
     sr_bind_phong_fs();
@@ -125,7 +127,7 @@ start()
 extern void
 update(float dt)
 {
-    sr_renderl(obj->indices, obj->n_indices, SR_TRIANGLE_LIST);
+    sr_draw_lods(obj->indices, obj->lods, obj->n_lods);
     sr_rotate_y(dt);
 }
 
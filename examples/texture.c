@@ -104,6 +104,7 @@ start()
  *********************************************************************/
 
     sr_bind_pts(obj->pts, obj->n_pts, obj->n_attr);
+    sr_bind_bounds(obj->bounds);
     sr_bind_texture(texture->colors, texture->width, texture->height);
 
     sr_bind_framebuffer(SCREEN_WIDTH, SCREEN_HEIGHT, colors, depths);
@@ -43,7 +43,7 @@ matmul(struct mat4* a, struct mat4* b)
     tmp.e32 = a->e30 * b->e02 + a->e31 * b->e12 + a->e32 * b->e22 + a->e33 * b->e32; 
     tmp.e33 = a->e30 * b->e03 + a->e31 * b->e13 + a->e32 * b->e23 + a->e33 * b->e33;
     *a = tmp;
-};
+}
 
 /**********
  * invert *
@@ -198,6 +198,121 @@ invert(struct mat4* a)
     return 1;
 }
 
+/*****************
+ * invert_affine *
+ *****************/
+
+/**
+ * inverts a matrix whose bottom row is 0 0 0 1, [A | t] becomes 
+ * [A^-1 | -A^-1 t], so only a 3x3 is inverted, returns 0 if singular
+ */
+
+int
+invert_affine(struct mat4* a)
+{
+    /* cofactors of the upper 3x3 */
+    float c00 = a->e11 * a->e22 - a->e12 * a->e21;
+    float c01 = a->e12 * a->e20 - a->e10 * a->e22;
+    float c02 = a->e10 * a->e21 - a->e11 * a->e20;
+
+    float det = a->e00 * c00 + a->e01 * c01 + a->e02 * c02;
+    if (det == 0)
+        return 0;
+    det = 1.0 / det;
+
+    struct mat4 tmp;
+
+    tmp.e00 = c00 * det;
+    tmp.e01 = (a->e02 * a->e21 - a->e01 * a->e22) * det;
+    tmp.e02 = (a->e01 * a->e12 - a->e02 * a->e11) * det;
+    tmp.e10 = c01 * det;
+    tmp.e11 = (a->e00 * a->e22 - a->e02 * a->e20) * det;
+    tmp.e12 = (a->e02 * a->e10 - a->e00 * a->e12) * det;
+    tmp.e20 = c02 * det;
+    tmp.e21 = (a->e01 * a->e20 - a->e00 * a->e21) * det;
+    tmp.e22 = (a->e00 * a->e11 - a->e01 * a->e10) * det;
+
+    tmp.e03 = -(tmp.e00 * a->e03 + tmp.e01 * a->e13 + tmp.e02 * a->e23);
+    tmp.e13 = -(tmp.e10 * a->e03 + tmp.e11 * a->e13 + tmp.e12 * a->e23);
+    tmp.e23 = -(tmp.e20 * a->e03 + tmp.e21 * a->e13 + tmp.e22 * a->e23);
+
+    tmp.e30 = 0;
+    tmp.e31 = 0;
+    tmp.e32 = 0;
+    tmp.e33 = 1;
+
+    *a = tmp;
+
+    return 1;
+}
+
+/****************
+ * invert_rigid *
+ ****************/
+
+/* inverts a rotation then translation, [R | t] becomes [R^T | -R^T t] */
+
+void
+invert_rigid(struct mat4* a)
+{
+    struct mat4 tmp;
+
+    tmp.e00 = a->e00;
+    tmp.e01 = a->e10;
+    tmp.e02 = a->e20;
+    tmp.e10 = a->e01;
+    tmp.e11 = a->e11;
+    tmp.e12 = a->e21;
+    tmp.e20 = a->e02;
+    tmp.e21 = a->e12;
+    tmp.e22 = a->e22;
+
+    tmp.e03 = -(tmp.e00 * a->e03 + tmp.e01 * a->e13 + tmp.e02 * a->e23);
+    tmp.e13 = -(tmp.e10 * a->e03 + tmp.e11 * a->e13 + tmp.e12 * a->e23);
+    tmp.e23 = -(tmp.e20 * a->e03 + tmp.e21 * a->e13 + tmp.e22 * a->e23);
+
+    tmp.e30 = 0;
+    tmp.e31 = 0;
+    tmp.e32 = 0;
+    tmp.e33 = 1;
+
+    *a = tmp;
+}
+
+/*************
+ * invert_as *
+ *************/
+
+/* inverts with the cheapest routine the kind allows, 0 if singular */
+
+int
+invert_as(struct mat4* a, enum mat_kind kind)
+{
+    switch (kind) {
+        case MAT_RIGID:
+            invert_rigid(a);
+            return 1;
+        case MAT_AFFINE:
+            return invert_affine(a);
+        default:
+            return invert(a);
+    }
+}
+
+/************
+ * mat_kind *
+ ************/
+
+/* the most that can be told about a matrix from its entries alone */
+
+enum mat_kind
+mat_kind(struct mat4* a)
+{
+    if (a->e30 == 0 && a->e31 == 0 && a->e32 == 0 && a->e33 == 1)
+        return MAT_AFFINE;
+    return MAT_GENERAL;
+}
+
 /*************
  * transpose *
  *************/
@@ -265,6 +380,30 @@ vec4_matmul(float* a, struct mat4* b, float* c)
     a[3] = c[0] * b->e30 + c[1] * b->e31 + c[2] * b->e32 + c[3] * b->e33;
 }
 
+/*****************
+ * vec4_matmul_n *
+ *****************/
+
+/**
+ * applys the matrix 'b' to 'n' vectors starting at 'c', 'stride' 
+ * floats apart, and stores the results in 'a' with the same stride, 
+ * only the first four floats of each vector are touched, and 'a' 
+ * may be 'c'
+ */
+
+void
+vec4_matmul_n(float* a, struct mat4* b, float* c, int n, int stride)
+{
+    for (int i = 0; i < n; i++) {
+        float tmp[4];
+        vec4_matmul(tmp, b, c + i * stride);
+        a[i * stride] = tmp[0];
+        a[i * stride + 1] = tmp[1];
+        a[i * stride + 2] = tmp[2];
+        a[i * stride + 3] = tmp[3];
+    }
+}
+
 /************
  * vec4_mul *
  ************/
@@ -0,0 +1,1470 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "sr.h"
+
+/**
+ * mesh.c
+ * --------
+ * reorders indexed triangle lists so they render with less work,
+ * meant to run once over a mesh after loading it
+ *
+ * triangles are first put in vertex cache order (forsyth's linear
+ * speed scoring), that order is cut into clusters where the cache
+ * would start over anyway, the clusters are sorted so the ones
+ * most likely to hide the rest come first, and finally points are
+ * renumbered in the order the indices first reach them
+ *
+ * meshlets cut the same cache order into small batches with bounds
+ * of their own, so whole batches can be culled before shading
+ *
+ * simplification collapses edges in the order of garland and
+ * heckbert's quadric error, onto points that already exist, so a
+ * coarser level of detail is just another index list into the
+ * same points
+ *
+ */
+
+#define CACHE_SIZE 32           /* vertex cache being scored for */
+#define CACHE_DECAY 1.5f
+#define LAST_TRI_SCORE 0.75f    /* points of the last triangle */
+#define VALENCE_SCALE 2.0f
+#define VALENCE_POWER 0.5f
+#define MAX_VALENCE 32          /* valence scores past this are equal */
+
+#define FIFO_SIZE 16            /* cache simulated to find clusters */
+#define OVERDRAW_THRESHOLD 1.05f
+
+#define BORDER_WEIGHT 10.0f     /* how firmly open borders hold */
+
+/*********************************************************************
+ *                                                                   *
+ *                      private declarations                         *
+ *                                                                   *
+ *********************************************************************/
+
+/*************
+ * adjacency *
+ *************/
+
+/* the triangles still waiting on each point, packed per point */
+
+struct adjacency {
+    int* offsets;       /* first slot of each point */
+    int* tris;
+    int* live;          /* triangles not yet emitted per point */
+};
+
+/***********
+ * cluster *
+ ***********/
+
+struct cluster {
+    int first;          /* first triangle */
+    int n_tris;
+    float center[3];    /* area weighted */
+    float normal[3];
+    float key;          /* larger draws earlier */
+};
+
+/***********
+ * quadric *
+ ***********/
+
+/**
+ * the weighted sum of squared distances to a set of planes, the
+ * upper triangle of a symmetric 4x4, in doubles since its terms
+ * cancel heavily
+ */
+
+struct quadric {
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+    double w;           /* summed weights, to make the sum a mean */
+};
+
+/************
+ * collapse *
+ ************/
+
+/* moving every corner at one welded point onto another */
+
+struct collapse {
+    int from;
+    int to;
+    float error;        /* mean squared distance the surface moves */
+};
+
+/************
+ * simplify *
+ ************/
+
+/**
+ * a triangle list being simplified, welded points are the first
+ * point of each position, so seams in the other attributes don't
+ * split the surface
+ */
+
+struct simplify {
+    int* indices;
+    int* welded;                /* 'indices' through the weld */
+    int n_tris;
+    float* pts;
+    int n_pts;
+    int n_attr;
+    struct quadric* quadrics;   /* per welded point */
+    struct adjacency adj;       /* of welded points, rebuilt each pass */
+    int* target;                /* point each moving point goes to */
+    int* stamp;                 /* the attempt that set 'target' */
+    int clock;                  /* counts collapse attempts */
+    uint8_t* locked;            /* touched earlier in this pass */
+};
+
+/*********************************************************************
+ *                                                                   *
+ *                             geometry                              *
+ *                                                                   *
+ *********************************************************************/
+
+/**************
+ * tri_normal *
+ **************/
+
+/**
+ * the unnormalized normal of a counter clockwise triangle into 'n', 
+ * returns its length, twice the triangle's area
+ */
+
+static inline float
+tri_normal(float* n, float* p0, float* p1, float* p2)
+{
+    float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+    return sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                           vertex cache                            *
+ *                                                                   *
+ *********************************************************************/
+
+/*******************
+ * build_adjacency *
+ *******************/
+
+/* lists the triangles around every point, returns 0 if out of memory */
+
+static int
+build_adjacency(struct adjacency* adj, int* indices,
+                int n_tris, int n_pts)
+{
+    adj->offsets = calloc(n_pts + 1, sizeof(int));
+    adj->tris = malloc(3 * (size_t)n_tris * sizeof(int));
+    adj->live = calloc(n_pts, sizeof(int));
+    if (!adj->offsets || !adj->tris || !adj->live)
+        return 0;
+
+    for (int i = 0; i < 3 * n_tris; i++)
+        adj->live[indices[i]]++;
+
+    for (int i = 0; i < n_pts; i++)
+        adj->offsets[i + 1] = adj->offsets[i] + adj->live[i];
+
+    int* fill = adj->live;      /* counts back up while filling */
+    memset(fill, 0, n_pts * sizeof(int));
+
+    for (int i = 0; i < 3 * n_tris; i++) {
+        int v = indices[i];
+        adj->tris[adj->offsets[v] + fill[v]++] = i / 3;
+    }
+
+    return 1;
+}
+
+/******************
+ * free_adjacency *
+ ******************/
+
+static void
+free_adjacency(struct adjacency* adj)
+{
+    free(adj->offsets);
+    free(adj->tris);
+    free(adj->live);
+}
+
+/****************
+ * vertex_score *
+ ****************/
+
+/**
+ * how much emitting a triangle through this point pays, high while
+ * it sits near the front of the cache and while few triangles
+ * still need it, so points get finished off rather than revisited
+ */
+
+static inline float
+vertex_score(int cache_pos, int live, float* cache_scores,
+             float* valence_scores)
+{
+    if (live == 0)
+        return -1;
+
+    float score = cache_pos < 0 ? 0 : cache_scores[cache_pos];
+    return score + valence_scores[live < MAX_VALENCE ? live : MAX_VALENCE];
+}
+
+/******************
+ * remove_emitted *
+ ******************/
+
+/* drops triangle 't' from the list of point 'v' */
+
+static inline void
+remove_emitted(struct adjacency* adj, int v, int t)
+{
+    int* tris = adj->tris + adj->offsets[v];
+    int last = --adj->live[v];
+
+    for (int i = 0; i <= last; i++) {
+        if (tris[i] == t) {
+            tris[i] = tris[last];
+            tris[last] = t;
+            return;
+        }
+    }
+}
+
+/*****************
+ * forsyth_order *
+ *****************/
+
+/**
+ * greedily emits the best scoring triangle among those touching the
+ * cache, rescoring only what the cache update changed, and falls
+ * back to the next triangle in input order when nothing is left
+ * around the cache
+ */
+
+static int
+forsyth_order(int* dest, int* indices, int n_tris, int n_pts)
+{
+    float cache_scores[CACHE_SIZE];
+    float valence_scores[MAX_VALENCE + 1];
+
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        if (i < 3) {
+            cache_scores[i] = LAST_TRI_SCORE;
+        } else {
+            float s = 1.0f - (float)(i - 3) / (CACHE_SIZE - 3);
+            cache_scores[i] = powf(s, CACHE_DECAY);
+        }
+    }
+
+    valence_scores[0] = 0;
+    for (int i = 1; i <= MAX_VALENCE; i++)
+        valence_scores[i] = VALENCE_SCALE * powf(i, -VALENCE_POWER);
+
+    struct adjacency adj = {0};
+    int* cache_pos = malloc(n_pts * sizeof(int));
+    float* scores = malloc(n_pts * sizeof(float));
+    uint8_t* emitted = calloc(n_tris, sizeof(uint8_t));
+
+    int ok = build_adjacency(&adj, indices, n_tris, n_pts) &&
+             cache_pos && scores && emitted;
+
+    if (!ok)
+        goto done;
+
+    for (int i = 0; i < n_pts; i++) {
+        cache_pos[i] = -1;
+        scores[i] = vertex_score(-1, adj.live[i],
+                                 cache_scores, valence_scores);
+    }
+
+    int best = 0;
+    float best_score = 0;
+    for (int i = 0; i < n_tris; i++) {
+        int* tri = indices + 3 * i;
+        float s = scores[tri[0]] + scores[tri[1]] + scores[tri[2]];
+        if (s > best_score) {
+            best_score = s;
+            best = i;
+        }
+    }
+
+    /* three extra slots hold what the newest triangle pushes out */
+
+    int cache[CACHE_SIZE + 3];
+    int next_cache[CACHE_SIZE + 3];
+    int n_cache = 0;
+    int cursor = 0;     /* where the input order fallback resumes */
+
+    for (int n = 0; n < n_tris; n++) {
+
+        if (best < 0) {
+            while (emitted[cursor])
+                cursor++;
+            best = cursor;
+        }
+
+        int* tri = indices + 3 * best;
+        memcpy(dest + 3 * n, tri, 3 * sizeof(int));
+        emitted[best] = 1;
+
+        for (int k = 0; k < 3; k++)
+            remove_emitted(&adj, tri[k], best);
+
+        /* the triangle's points move to the front, the rest shift back */
+
+        int n_next = 0;
+        for (int k = 0; k < 3; k++) {
+            if (k == 0 || tri[k] != tri[k - 1])     /* degenerate */
+                next_cache[n_next++] = tri[k];
+        }
+
+        for (int i = 0; i < n_cache; i++) {
+            int v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                next_cache[n_next++] = v;
+        }
+
+        for (int i = 0; i < n_next; i++) {
+            int v = next_cache[i];
+            cache_pos[v] = i < CACHE_SIZE ? i : -1;
+            scores[v] = vertex_score(cache_pos[v], adj.live[v],
+                                     cache_scores, valence_scores);
+        }
+
+        /* rescore the triangles around anything that moved */
+
+        best = -1;
+        best_score = 0;
+
+        for (int i = 0; i < n_next; i++) {
+            int v = next_cache[i];
+            int* tris = adj.tris + adj.offsets[v];
+
+            for (int j = 0; j < adj.live[v]; j++) {
+                int* t = indices + 3 * tris[j];
+                float s = scores[t[0]] + scores[t[1]] + scores[t[2]];
+                if (s > best_score) {
+                    best_score = s;
+                    best = tris[j];
+                }
+            }
+        }
+
+        n_cache = n_next < CACHE_SIZE ? n_next : CACHE_SIZE;
+        memcpy(cache, next_cache, n_cache * sizeof(int));
+    }
+
+done:
+    free_adjacency(&adj);
+    free(cache_pos);
+    free(scores);
+    free(emitted);
+
+    return ok;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             overdraw                              *
+ *                                                                   *
+ *********************************************************************/
+
+/***************
+ * fifo_misses *
+ ***************/
+
+/**
+ * runs one triangle through a simulated fifo cache of FIFO_SIZE,
+ * 'stamps' holds the time each point went in and 'clock' counts
+ * misses, returns the misses of this triangle
+ */
+
+static inline int
+fifo_misses(int* tri, int* stamps, int* clock)
+{
+    int misses = 0;
+
+    for (int k = 0; k < 3; k++) {
+        int v = tri[k];
+        if (stamps[v] < 0 || *clock - stamps[v] >= FIFO_SIZE) {
+            stamps[v] = (*clock)++;
+            misses++;
+        }
+    }
+
+    return misses;
+}
+
+/*****************
+ * find_clusters *
+ *****************/
+
+/**
+ * cuts a cache ordered triangle list into runs that can be moved
+ * without costing much in the cache, a run ends where the cache
+ * starts over on its own (a triangle missing all three points) or
+ * once its own miss ratio drops to 'threshold' times the whole
+ * list's, returns the number of clusters or 0 if out of memory
+ */
+
+static int
+find_clusters(int* indices, int n_tris, int n_pts, float threshold,
+              struct cluster* clusters)
+{
+    int* stamps = malloc(n_pts * sizeof(int));
+    if (!stamps)
+        return 0;
+
+    /* miss ratio of the list as it stands */
+
+    memset(stamps, -1, n_pts * sizeof(int));
+    int clock = 0;
+    for (int i = 0; i < n_tris; i++)
+        fifo_misses(indices + 3 * i, stamps, &clock);
+
+    float limit = threshold * clock / n_tris;
+
+    /* each cluster starts with a flushed cache */
+
+    memset(stamps, -1, n_pts * sizeof(int));
+    clock = 0;
+
+    int n_clusters = 0;
+    int start = 0;
+    int misses = 0;
+
+    for (int i = 0; i < n_tris; i++) {
+
+        int m = fifo_misses(indices + 3 * i, stamps, &clock);
+
+        if (m == 3 && i > start) {      /* cache started over */
+            clusters[n_clusters++].first = start;
+            start = i;
+            misses = 0;
+        }
+
+        misses += m;
+
+        if ((float)misses / (i - start + 1) <= limit && i + 1 < n_tris) {
+            clusters[n_clusters++].first = start;
+            start = i + 1;
+            misses = 0;
+            clock += FIFO_SIZE;         /* flush */
+        }
+    }
+
+    clusters[n_clusters++].first = start;
+
+    for (int i = 0; i < n_clusters; i++) {
+        int end = i + 1 < n_clusters ? clusters[i + 1].first : n_tris;
+        clusters[i].n_tris = end - clusters[i].first;
+    }
+
+    free(stamps);
+    return n_clusters;
+}
+
+/****************
+ * cluster_keys *
+ ****************/
+
+/**
+ * scores each cluster by how far its center lies out from the
+ * mesh's along its average normal, clusters on the outside facing
+ * out are the likeliest to cover others so they draw first
+ */
+
+static void
+cluster_keys(int* indices, float* pts, int n_attr,
+             struct cluster* clusters, int n_clusters)
+{
+    float mesh_center[3] = {0};
+    float mesh_area = 0;
+
+    for (int i = 0; i < n_clusters; i++) {
+
+        struct cluster* c = clusters + i;
+        float area = 0;
+        memset(c->center, 0, sizeof(c->center));
+        memset(c->normal, 0, sizeof(c->normal));
+
+        for (int t = c->first; t < c->first + c->n_tris; t++) {
+            float* p0 = pts + indices[3 * t] * n_attr;
+            float* p1 = pts + indices[3 * t + 1] * n_attr;
+            float* p2 = pts + indices[3 * t + 2] * n_attr;
+
+            float n[3];
+            float a = tri_normal(n, p0, p1, p2);
+            for (int k = 0; k < 3; k++) {
+                c->center[k] += a * (p0[k] + p1[k] + p2[k]) / 3;
+                c->normal[k] += n[k];
+            }
+            area += a;
+        }
+
+        for (int k = 0; k < 3; k++)
+            mesh_center[k] += c->center[k];
+        mesh_area += area;
+
+        if (area > 0) {
+            for (int k = 0; k < 3; k++)
+                c->center[k] /= area;
+        }
+    }
+
+    if (mesh_area > 0) {
+        for (int k = 0; k < 3; k++)
+            mesh_center[k] /= mesh_area;
+    }
+
+    for (int i = 0; i < n_clusters; i++) {
+        struct cluster* c = clusters + i;
+        float* n = c->normal;
+        float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+        c->key = 0;
+        if (len == 0)       /* closed or empty */
+            continue;
+
+        for (int k = 0; k < 3; k++)
+            c->key += (c->center[k] - mesh_center[k]) * n[k] / len;
+    }
+}
+
+/********************
+ * compare_clusters *
+ ********************/
+
+/* descending key, ties keep their order */
+
+static int
+compare_clusters(const void* a, const void* b)
+{
+    const struct cluster* ca = a;
+    const struct cluster* cb = b;
+
+    if (ca->key != cb->key)
+        return ca->key < cb->key ? 1 : -1;
+    return ca->first - cb->first;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             meshlets                              *
+ *                                                                   *
+ *********************************************************************/
+
+/******************
+ * meshlet_bounds *
+ ******************/
+
+/**
+ * fits a sphere around a finished meshlet's points and a cone 
+ * around its triangles' normals, a cone wider than a half sphere 
+ * gets a cutoff of 1 so it never culls
+ */
+
+static void
+meshlet_bounds(struct sr_meshlet* m, float* pts, int n_pts, 
+               int n_attr, int* indices)
+{
+    float lo[3] = {INFINITY, INFINITY, INFINITY};
+    float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+    for (int i = 0; i < n_pts; i++) {
+        float* p = pts + i * n_attr;
+        for (int k = 0; k < 3; k++) {
+            lo[k] = p[k] < lo[k] ? p[k] : lo[k];
+            hi[k] = p[k] > hi[k] ? p[k] : hi[k];
+        }
+    }
+
+    float r2 = 0;
+    for (int k = 0; k < 3; k++)
+        m->center[k] = (lo[k] + hi[k]) / 2;
+
+    for (int i = 0; i < n_pts; i++) {
+        float* p = pts + i * n_attr;
+        float d[3] = {
+            p[0] - m->center[0], p[1] - m->center[1], p[2] - m->center[2]
+        };
+        float dd = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        r2 = dd > r2 ? dd : r2;
+    }
+    m->radius = sqrtf(r2);
+
+    /* the cone axis averages unit normals, the cutoff fits the widest */
+
+    float axis[3] = {0};
+    for (int i = 0; i < m->n_indices; i += 3) {
+        float n[3];
+        float len = tri_normal(n, pts + indices[i] * n_attr,
+                               pts + indices[i + 1] * n_attr,
+                               pts + indices[i + 2] * n_attr);
+        if (len == 0)
+            continue;
+        for (int k = 0; k < 3; k++)
+            axis[k] += n[k] / len;
+    }
+
+    float len = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + 
+                      axis[2] * axis[2]);
+
+    m->cone_cutoff = 1;
+    memset(m->cone_axis, 0, sizeof(m->cone_axis));
+    if (len == 0)
+        return;
+
+    for (int k = 0; k < 3; k++)
+        m->cone_axis[k] = axis[k] / len;
+
+    float min_dp = 1;
+    for (int i = 0; i < m->n_indices; i += 3) {
+        float n[3];
+        float tri_len = tri_normal(n, pts + indices[i] * n_attr,
+                                   pts + indices[i + 1] * n_attr,
+                                   pts + indices[i + 2] * n_attr);
+        if (tri_len == 0)
+            continue;
+        float dp = (n[0] * m->cone_axis[0] + n[1] * m->cone_axis[1] + 
+                    n[2] * m->cone_axis[2]) / tri_len;
+        min_dp = dp < min_dp ? dp : min_dp;
+    }
+
+    if (min_dp > 0)     /* sine of the half angle */
+        m->cone_cutoff = sqrtf(1 - min_dp * min_dp);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                          simplification                           *
+ *                                                                   *
+ *********************************************************************/
+
+/********
+ * weld *
+ ********/
+
+/**
+ * maps every point to the first point with the same position,
+ * returns 0 if out of memory
+ */
+
+static int
+weld(int* remap, float* pts, int n_pts, int n_attr)
+{
+    int cap = 16;
+    while (cap < 2 * n_pts)
+        cap *= 2;
+
+    int* table = malloc(cap * sizeof(int));
+    if (!table)
+        return 0;
+    memset(table, -1, cap * sizeof(int));
+
+    for (int i = 0; i < n_pts; i++) {
+        float* p = pts + i * n_attr;
+        uint32_t bits[3];
+        memcpy(bits, p, sizeof(bits));
+
+        uint32_t h = bits[0] * 0x9e3779b1u ^ bits[1] * 0x85ebca77u ^
+                     bits[2] * 0xc2b2ae3du;
+        uint32_t slot = (h ^ (h >> 15)) & (cap - 1);
+
+        for (;;) {
+            int j = table[slot];
+            if (j < 0) {
+                table[slot] = i;
+                remap[i] = i;
+                break;
+            }
+            if (!memcmp(pts + j * n_attr, p, 3 * sizeof(float))) {
+                remap[i] = j;
+                break;
+            }
+            slot = (slot + 1) & (cap - 1);
+        }
+    }
+
+    free(table);
+    return 1;
+}
+
+/*****************
+ * quadric_plane *
+ *****************/
+
+/* adds the plane through 'p' with unit normal 'n', weighted by 'w' */
+
+static void
+quadric_plane(struct quadric* q, float* n, float* p, float w)
+{
+    double a = n[0];
+    double b = n[1];
+    double c = n[2];
+    double d = -(a * p[0] + b * p[1] + c * p[2]);
+
+    q->a2 += w * a * a;
+    q->ab += w * a * b;
+    q->ac += w * a * c;
+    q->ad += w * a * d;
+    q->b2 += w * b * b;
+    q->bc += w * b * c;
+    q->bd += w * b * d;
+    q->c2 += w * c * c;
+    q->cd += w * c * d;
+    q->d2 += w * d * d;
+    q->w += w;
+}
+
+/***************
+ * quadric_add *
+ ***************/
+
+static void
+quadric_add(struct quadric* dest, struct quadric* src)
+{
+    dest->a2 += src->a2;
+    dest->ab += src->ab;
+    dest->ac += src->ac;
+    dest->ad += src->ad;
+    dest->b2 += src->b2;
+    dest->bc += src->bc;
+    dest->bd += src->bd;
+    dest->c2 += src->c2;
+    dest->cd += src->cd;
+    dest->d2 += src->d2;
+    dest->w += src->w;
+}
+
+/*****************
+ * quadric_error *
+ *****************/
+
+/* the mean squared distance from 'p' to the planes of 'q' */
+
+static float
+quadric_error(struct quadric* q, float* p)
+{
+    double x = p[0];
+    double y = p[1];
+    double z = p[2];
+
+    double e = q->a2 * x * x + q->b2 * y * y + q->c2 * z * z +
+               2 * (q->ab * x * y + q->ac * x * z + q->bc * y * z) +
+               2 * (q->ad * x + q->bd * y + q->cd * z) + q->d2;
+
+    return q->w > 0 && e > 0 ? e / q->w : 0;
+}
+
+/***************
+ * shares_edge *
+ ***************/
+
+/* true if a triangle other than 't' also has the welded edge 'a' 'b' */
+
+static int
+shares_edge(struct simplify* s, int t, int a, int b)
+{
+    for (int i = s->adj.offsets[a]; i < s->adj.offsets[a + 1]; i++) {
+        int u = s->adj.tris[i];
+        int* w = s->welded + 3 * u;
+        if (u != t && (w[0] == b || w[1] == b || w[2] == b))
+            return 1;
+    }
+
+    return 0;
+}
+
+/******************
+ * build_quadrics *
+ ******************/
+
+/**
+ * gives each welded point the planes of its triangles weighted by
+ * area, and along open borders a plane standing up from the edge
+ * so the outline holds its shape
+ */
+
+static void
+build_quadrics(struct simplify* s)
+{
+    for (int t = 0; t < s->n_tris; t++) {
+
+        int* w = s->welded + 3 * t;
+        float* p[3];
+        for (int k = 0; k < 3; k++)
+            p[k] = s->pts + w[k] * s->n_attr;
+
+        float n[3];
+        float len = tri_normal(n, p[0], p[1], p[2]);
+        if (len == 0)
+            continue;
+        for (int k = 0; k < 3; k++)
+            n[k] /= len;
+
+        for (int k = 0; k < 3; k++)
+            quadric_plane(s->quadrics + w[k], n, p[0], len / 2);
+
+        for (int k = 0; k < 3; k++) {
+            int a = w[k];
+            int b = w[(k + 1) % 3];
+            if (shares_edge(s, t, a, b))
+                continue;
+
+            float* pa = p[k];
+            float* pb = p[(k + 1) % 3];
+            float e[3] = {pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2]};
+            float m[3] = {
+                e[1] * n[2] - e[2] * n[1],
+                e[2] * n[0] - e[0] * n[2],
+                e[0] * n[1] - e[1] * n[0]
+            };
+
+            float m_len = sqrtf(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+            if (m_len == 0)
+                continue;
+            for (int j = 0; j < 3; j++)
+                m[j] /= m_len;
+
+            quadric_plane(s->quadrics + a, m, pa, BORDER_WEIGHT * m_len * m_len);
+            quadric_plane(s->quadrics + b, m, pa, BORDER_WEIGHT * m_len * m_len);
+        }
+    }
+}
+
+/*****************
+ * collapse_cost *
+ *****************/
+
+/* how far moving welded point 'from' onto 'to' moves the surface */
+
+static float
+collapse_cost(struct simplify* s, int from, int to)
+{
+    struct quadric q = s->quadrics[from];
+    quadric_add(&q, s->quadrics + to);
+    return quadric_error(&q, s->pts + to * s->n_attr);
+}
+
+/*********************
+ * compare_collapses *
+ *********************/
+
+/* ascending error */
+
+static int
+compare_collapses(const void* a, const void* b)
+{
+    const struct collapse* ca = a;
+    const struct collapse* cb = b;
+
+    if (ca->error != cb->error)
+        return ca->error < cb->error ? -1 : 1;
+    return 0;
+}
+
+/****************
+ * try_collapse *
+ ****************/
+
+/**
+ * moves each corner at welded point 'c->from' onto a point at 
+ * 'c->to' that it already shares a triangle with, so seams in the 
+ * other attributes stay closed, refused if some corner has no such 
+ * point or a triangle would flip
+ * 
+ * returns the triangles the collapse removed, or -1 if refused
+ */
+
+static int
+try_collapse(struct simplify* s, struct collapse* c)
+{
+    int a = c->from;
+    int b = c->to;
+    int first = s->adj.offsets[a];
+    int last = s->adj.offsets[a + 1];
+    float* pb = s->pts + b * s->n_attr;
+
+    s->clock++;
+
+    /* pair the points at 'a' with points at 'b' across triangles */
+
+    for (int i = first; i < last; i++) {
+        int t = s->adj.tris[i];
+        int* tri = s->indices + 3 * t;
+        int* w = s->welded + 3 * t;
+
+        for (int k = 0; k < 3; k++) {
+            if (w[k] != a || s->stamp[tri[k]] == s->clock)
+                continue;
+            for (int j = 0; j < 3; j++) {
+                if (w[j] == b) {
+                    s->target[tri[k]] = tri[j];
+                    s->stamp[tri[k]] = s->clock;
+                }
+            }
+        }
+    }
+
+    /* every corner needs a partner, nothing may turn over */
+
+    for (int i = first; i < last; i++) {
+        int t = s->adj.tris[i];
+        int* tri = s->indices + 3 * t;
+        int* w = s->welded + 3 * t;
+
+        float* before[3];
+        float* after[3];
+        for (int k = 0; k < 3; k++) {
+            if (w[k] == a && s->stamp[tri[k]] != s->clock)
+                return -1;
+            before[k] = s->pts + w[k] * s->n_attr;
+            after[k] = w[k] == a ? pb : before[k];
+        }
+
+        if (w[0] == b || w[1] == b || w[2] == b)
+            continue;
+
+        float n0[3];
+        float n1[3];
+        tri_normal(n0, before[0], before[1], before[2]);
+        tri_normal(n1, after[0], after[1], after[2]);
+        if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0)
+            return -1;
+    }
+
+    int removed = 0;
+    for (int i = first; i < last; i++) {
+        int t = s->adj.tris[i];
+        int* tri = s->indices + 3 * t;
+        int* w = s->welded + 3 * t;
+
+        if (w[0] == b || w[1] == b || w[2] == b)
+            removed++;
+
+        for (int k = 0; k < 3; k++) {
+            if (w[k] == a) {
+                tri[k] = s->target[tri[k]];
+                w[k] = b;
+            }
+        }
+    }
+
+    return removed;
+}
+
+/*****************
+ * collapse_pass *
+ *****************/
+
+/**
+ * collapses the sorted candidates up to error 'limit' until 'goal' 
+ * triangles are gone, skipping any near an earlier collapse of the 
+ * pass since their adjacency and quadrics are stale, returns the 
+ * triangles removed
+ */
+
+static int
+collapse_pass(struct simplify* s, struct collapse* cands, int n_cands, 
+              int goal, float limit, float* max_error)
+{
+    memset(s->locked, 0, s->n_pts);
+
+    int removed = 0;
+    for (int i = 0; i < n_cands && removed < goal; i++) {
+
+        struct collapse* c = cands + i;
+        if (c->error > limit)
+            break;
+        if (s->locked[c->from] || s->locked[c->to])
+            continue;
+
+        int n = try_collapse(s, c);
+        if (n < 0)
+            continue;
+
+        removed += n;
+        if (c->error > *max_error)
+            *max_error = c->error;
+        quadric_add(s->quadrics + c->to, s->quadrics + c->from);
+
+        /* the triangles that were around 'from' now reach 'to' */
+
+        for (int j = s->adj.offsets[c->from]; 
+             j < s->adj.offsets[c->from + 1]; j++) {
+            int* w = s->welded + 3 * s->adj.tris[j];
+            s->locked[w[0]] = s->locked[w[1]] = s->locked[w[2]] = 1;
+        }
+    }
+
+    return removed;
+}
+
+/*************
+ * drop_flat *
+ *************/
+
+/* removes triangles that collapses left with two corners at one point */
+
+static void
+drop_flat(struct simplify* s)
+{
+    int n = 0;
+    for (int t = 0; t < s->n_tris; t++) {
+        int* w = s->welded + 3 * t;
+        if (w[0] == w[1] || w[1] == w[2] || w[2] == w[0])
+            continue;
+        memmove(s->indices + 3 * n, s->indices + 3 * t, 3 * sizeof(int));
+        memmove(s->welded + 3 * n, w, 3 * sizeof(int));
+        n++;
+    }
+    s->n_tris = n;
+}
+
+/*******************
+ * simplify_passes *
+ *******************/
+
+/**
+ * collapses edges in passes until 'target_tris' are left, each pass 
+ * scores every edge both ways, then takes the cheapest third, or 
+ * everything if none of those could go, returns 0 if out of memory
+ */
+
+static int
+simplify_passes(struct simplify* s, struct collapse* cands, 
+                int target_tris, float* max_error)
+{
+    while (s->n_tris > target_tris) {
+
+        free_adjacency(&s->adj);
+        memset(&s->adj, 0, sizeof(s->adj));
+        if (!build_adjacency(&s->adj, s->welded, s->n_tris, s->n_pts))
+            return 0;
+
+        int n_cands = 0;
+        for (int t = 0; t < s->n_tris; t++) {
+            int* w = s->welded + 3 * t;
+            for (int k = 0; k < 3; k++) {
+                int a = w[k];
+                int b = w[(k + 1) % 3];
+                cands[n_cands++] = (struct collapse){
+                    a, b, collapse_cost(s, a, b)
+                };
+                cands[n_cands++] = (struct collapse){
+                    b, a, collapse_cost(s, b, a)
+                };
+            }
+        }
+        qsort(cands, n_cands, sizeof(struct collapse), compare_collapses);
+
+        int goal = s->n_tris - target_tris;
+        float limit = cands[n_cands / 3].error;
+
+        int removed = collapse_pass(s, cands, n_cands, goal, 
+                                    limit, max_error);
+        if (removed == 0)
+            removed = collapse_pass(s, cands, n_cands, goal, 
+                                    INFINITY, max_error);
+        if (removed == 0)
+            break;
+
+        drop_flat(s);
+    }
+
+    return 1;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                         public definition                         *
+ *                                                                   *
+ *********************************************************************/
+
+/****************************
+ * sr_optimize_vertex_cache *
+ ****************************/
+
+/**
+ * reorders the triangles of a triangle list so consecutive ones
+ * share points, 'dest' may be 'indices', returns 0 if out of memory
+ */
+
+extern int
+sr_optimize_vertex_cache(int* dest, int* indices,
+                         int n_indices, int n_pts)
+{
+    int n_tris = n_indices / 3;
+    int* tmp = malloc(3 * (size_t)n_tris * sizeof(int));
+    if (!tmp)
+        return 0;
+
+    int ok = forsyth_order(tmp, indices, n_tris, n_pts);
+    if (ok)
+        memcpy(dest, tmp, 3 * (size_t)n_tris * sizeof(int));
+
+    free(tmp);
+    return ok;
+}
+
+/************************
+ * sr_optimize_overdraw *
+ ************************/
+
+/**
+ * reorders clusters of a cache ordered triangle list so the outer
+ * surfaces draw first and more of what's behind them fails the
+ * depth test, positions are the first three attributes of 'pts'
+ *
+ * 'threshold' bounds how much worse than the input a cluster may
+ * use the vertex cache, 1.05 allows 5%, higher gives more clusters
+ * to sort, 'dest' may be 'indices', returns 0 if out of memory
+ */
+
+extern int
+sr_optimize_overdraw(int* dest, int* indices, int n_indices,
+                     float* pts, int n_pts, int n_attr, float threshold)
+{
+    int n_tris = n_indices / 3;
+    if (n_tris == 0)
+        return 1;
+
+    struct cluster* clusters = malloc(n_tris * sizeof(struct cluster));
+    int* tmp = malloc(3 * (size_t)n_tris * sizeof(int));
+    int n_clusters = 0;
+
+    if (clusters && tmp)
+        n_clusters = find_clusters(indices, n_tris, n_pts,
+                                   threshold, clusters);
+
+    if (n_clusters == 0) {
+        free(clusters);
+        free(tmp);
+        return 0;
+    }
+
+    cluster_keys(indices, pts, n_attr, clusters, n_clusters);
+    qsort(clusters, n_clusters, sizeof(struct cluster), compare_clusters);
+
+    int n = 0;
+    for (int i = 0; i < n_clusters; i++) {
+        int size = 3 * clusters[i].n_tris;
+        memcpy(tmp + n, indices + 3 * clusters[i].first,
+               size * sizeof(int));
+        n += size;
+    }
+
+    memcpy(dest, tmp, n * sizeof(int));
+
+    free(clusters);
+    free(tmp);
+    return 1;
+}
+
+/****************************
+ * sr_optimize_vertex_fetch *
+ ****************************/
+
+/**
+ * renumbers points in the order the indices first use them and
+ * moves them to match, in place, so the pipeline reads 'pts' front
+ * to back, points no index uses are dropped
+ *
+ * returns the new number of points, or -1 if out of memory
+ */
+
+extern int
+sr_optimize_vertex_fetch(float* pts, int n_pts, int n_attr,
+                         int* indices, int n_indices)
+{
+    int* remap = malloc(n_pts * sizeof(int));
+    float* tmp = malloc((size_t)n_pts * n_attr * sizeof(float));
+    if (!remap || !tmp) {
+        free(remap);
+        free(tmp);
+        return -1;
+    }
+
+    memset(remap, -1, n_pts * sizeof(int));
+
+    int n_used = 0;
+    for (int i = 0; i < n_indices; i++) {
+        int v = indices[i];
+        if (remap[v] < 0) {
+            remap[v] = n_used++;
+            memcpy(tmp + remap[v] * n_attr, pts + v * n_attr,
+                   n_attr * sizeof(float));
+        }
+        indices[i] = remap[v];
+    }
+
+    memcpy(pts, tmp, (size_t)n_used * n_attr * sizeof(float));
+
+    free(remap);
+    free(tmp);
+    return n_used;
+}
+
+/*******************
+ * sr_optimize_obj *
+ *******************/
+
+/**
+ * runs all three passes over a loaded mesh, the first two over each 
+ * level of detail on its own, then fetch order over all of them so 
+ * the full detail level reads its points front to back, returns 0 
+ * if out of memory
+ */
+
+extern int
+sr_optimize_obj(struct sr_obj* obj)
+{
+    for (int i = 0; i < obj->n_lods; i++) {
+        int* indices = obj->indices + obj->lods[i].first_index;
+        int n_indices = obj->lods[i].n_indices;
+
+        if (!sr_optimize_vertex_cache(indices, indices, n_indices, 
+                                      obj->n_pts))
+            return 0;
+
+        if (!sr_optimize_overdraw(indices, indices, n_indices,
+                                  obj->pts, obj->n_pts, obj->n_attr,
+                                  OVERDRAW_THRESHOLD))
+            return 0;
+    }
+
+    struct sr_lod* last = obj->lods + obj->n_lods - 1;
+    int n_pts = sr_optimize_vertex_fetch(obj->pts, obj->n_pts,
+                                         obj->n_attr, obj->indices,
+                                         last->first_index + 
+                                         last->n_indices);
+    if (n_pts < 0)
+        return 0;
+
+    obj->n_pts = n_pts;
+    return 1;
+}
+
+/***************
+ * sr_simplify *
+ ***************/
+
+/**
+ * collapses edges of a triangle list, the ones that move the surface 
+ * least first, until at most 'target' indices are left or no edge 
+ * can go without opening a seam or flipping a triangle, positions 
+ * are the first three attributes of 'pts'
+ *
+ * every collapse moves a point onto a neighbour that already exists,
+ * so the result still indexes 'pts' and needs no new points, it is 
+ * written to 'dest', which may be 'indices'
+ *
+ * 'error', if not null, gets about how far the surface moved in 
+ * model units, returns the new number of indices, or -1 if out of 
+ * memory
+ */
+
+extern int
+sr_simplify(int* dest, int* indices, int n_indices, float* pts, 
+            int n_pts, int n_attr, int target, float* error)
+{
+    int n_tris = n_indices / 3;
+
+    struct simplify s = {
+        .n_tris = n_tris,
+        .pts = pts,
+        .n_pts = n_pts,
+        .n_attr = n_attr
+    };
+
+    size_t n_corners = 3 * (size_t)n_tris + 1;
+    s.indices = malloc(n_corners * sizeof(int));
+    s.welded = malloc(n_corners * sizeof(int));
+    s.quadrics = calloc(n_pts + 1, sizeof(struct quadric));
+    s.target = malloc((n_pts + 1) * sizeof(int));
+    s.stamp = calloc(n_pts + 1, sizeof(int));
+    s.locked = malloc(n_pts + 1);
+    int* remap = malloc((n_pts + 1) * sizeof(int));
+    struct collapse* cands = malloc(2 * n_corners * sizeof(struct collapse));
+
+    float max_error = 0;
+    int ok = s.indices && s.welded && s.quadrics && s.target && 
+             s.stamp && s.locked && remap && cands &&
+             weld(remap, pts, n_pts, n_attr);
+
+    if (ok) {
+        memcpy(s.indices, indices, 3 * (size_t)n_tris * sizeof(int));
+        for (int i = 0; i < 3 * n_tris; i++)
+            s.welded[i] = remap[s.indices[i]];
+        drop_flat(&s);
+
+        ok = build_adjacency(&s.adj, s.welded, s.n_tris, n_pts);
+    }
+
+    if (ok) {
+        build_quadrics(&s);
+        ok = simplify_passes(&s, cands, target / 3, &max_error);
+    }
+
+    if (ok)
+        memcpy(dest, s.indices, 3 * (size_t)s.n_tris * sizeof(int));
+    if (error)
+        *error = sqrtf(max_error);
+
+    free_adjacency(&s.adj);
+    free(s.indices);
+    free(s.welded);
+    free(s.quadrics);
+    free(s.target);
+    free(s.stamp);
+    free(s.locked);
+    free(remap);
+    free(cands);
+
+    return ok ? 3 * s.n_tris : -1;
+}
+
+/*********************
+ * sr_build_meshlets *
+ *********************/
+
+/**
+ * cuts a triangle list into meshlets of at most SR_MESHLET_MAX_PTS 
+ * points and SR_MESHLET_MAX_TRIS triangles, taken in vertex cache 
+ * order so neighbours land together
+ *
+ * each meshlet gets its own copy of the points it uses, so its 
+ * indices stay small and a draw of it shades nothing else, points 
+ * on a seam are copied into every meshlet sharing them
+ *
+ * returns null if out of memory
+ */
+
+extern struct sr_meshlets*
+sr_build_meshlets(float* pts, int n_pts, int n_attr, 
+                  int* indices, int n_indices)
+{
+    int n_tris = n_indices / 3;
+
+    struct sr_meshlets* ml = calloc(1, sizeof(struct sr_meshlets));
+    int* order = malloc((3 * (size_t)n_tris + 1) * sizeof(int));
+    int* local = malloc((n_pts + 1) * sizeof(int));
+    if (!ml || !order || !local)
+        goto fail;
+
+    ml->n_attr = n_attr;
+    ml->pts = malloc(((size_t)3 * n_tris * n_attr + 1) * sizeof(float));
+    ml->indices = malloc((3 * (size_t)n_tris + 1) * sizeof(int));
+    ml->meshlets = malloc((n_tris + 1) * sizeof(struct sr_meshlet));
+    if (!ml->pts || !ml->indices || !ml->meshlets)
+        goto fail;
+
+    if (!forsyth_order(order, indices, n_tris, n_pts))
+        goto fail;
+
+    memset(local, -1, n_pts * sizeof(int));
+
+    int members[SR_MESHLET_MAX_PTS];    /* source points of the current */
+    int n_members = 0;
+    struct sr_meshlet* cur = 0;
+
+    for (int t = 0; t < n_tris; t++) {
+
+        int* tri = order + 3 * t;
+        int n_new = 0;
+        for (int k = 0; k < 3; k++) {
+            int v = tri[k];
+            if (local[v] < 0 && (k == 0 || v != tri[0]) && 
+                (k < 2 || v != tri[1]))
+                n_new++;
+        }
+
+        /* start a new meshlet when this triangle won't fit */
+
+        if (!cur || n_members + n_new > SR_MESHLET_MAX_PTS || 
+            cur->n_indices == 3 * SR_MESHLET_MAX_TRIS) {
+
+            if (cur) {
+                meshlet_bounds(cur, ml->pts + cur->base_vertex * n_attr, 
+                               n_members, n_attr, 
+                               ml->indices + cur->first_index);
+                for (int i = 0; i < n_members; i++)
+                    local[members[i]] = -1;
+            }
+
+            cur = ml->meshlets + ml->n_meshlets++;
+            cur->first_index = ml->n_indices;
+            cur->n_indices = 0;
+            cur->base_vertex = ml->n_pts;
+            n_members = 0;
+        }
+
+        for (int k = 0; k < 3; k++) {
+            int v = tri[k];
+            if (local[v] < 0) {
+                local[v] = n_members;
+                members[n_members++] = v;
+                memcpy(ml->pts + ml->n_pts * n_attr, pts + v * n_attr, 
+                       n_attr * sizeof(float));
+                ml->n_pts++;
+            }
+            ml->indices[ml->n_indices++] = local[v];
+        }
+        cur->n_indices += 3;
+    }
+
+    if (cur)
+        meshlet_bounds(cur, ml->pts + cur->base_vertex * n_attr, 
+                       n_members, n_attr, ml->indices + cur->first_index);
+
+    /* give back what seams didn't use */
+
+    float* fit = realloc(ml->pts, 
+                         ((size_t)ml->n_pts * n_attr + 1) * sizeof(float));
+    if (fit)
+        ml->pts = fit;
+
+    free(order);
+    free(local);
+    return ml;
+
+fail:
+    free(order);
+    free(local);
+    sr_meshlets_free(ml);
+    return 0;
+}
+
+/********************
+ * sr_meshlets_free *
+ ********************/
+
+/* frees meshlets from sr_build_meshlets */
+
+extern void
+sr_meshlets_free(struct sr_meshlets* ml)
+{
+    if (!ml)
+        return;
+    free(ml->pts);
+    free(ml->indices);
+    free(ml->meshlets);
+    free(ml);
+}
@@ -0,0 +1,1007 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sr.h"
+
+/**
+ * obj.c
+ * --------
+ * loads wavefront .obj meshes into the indexed point layout
+ * the pipeline renders, one point per distinct corner
+ *
+ * the file is memory mapped and cut into chunks at line breaks,
+ * threads count the records of each chunk, the counts give every
+ * chunk its offsets into the shared arrays, then threads parse
+ * their chunk straight into place, so nothing is copied or merged
+ *
+ * coarser levels of detail are simplified from the full mesh into
+ * the same index buffer, each a quarter of the one before
+ *
+ * the result is saved next to the obj as a cache in its final 
+ * layout, later loads of an unchanged obj map the cache and point 
+ * straight into it
+ *
+ */
+
+/* points come out as x, y, z, u, v, nx, ny, nz */
+#define OBJ_N_ATTR 8
+
+#define MAX_THREADS 16
+#define MIN_CHUNK_SIZE (1 << 20)
+
+#define CACHE_SUFFIX ".cache"
+#define CACHE_MAGIC "sr_obj\0"
+#define CACHE_VERSION 3
+
+#define LOD_REDUCTION 4         /* triangles of a level over the next */
+#define MIN_LOD_TRIS 16         /* no level is made smaller than this */
+
+/*********************************************************************
+ *                                                                   *
+ *                          parse state                              *
+ *                                                                   *
+ *********************************************************************/
+
+/*********
+ * chunk *
+ *********/
+
+/* a range of whole lines and what was found in it */
+
+struct chunk {
+    const char* begin;
+    const char* end;
+
+    /* records in this chunk, filled by the counting pass */
+    int n_v;
+    int n_vt;
+    int n_vn;
+    int n_tris;
+
+    /* records in all earlier chunks, where this chunk writes */
+    int v_off;
+    int vt_off;
+    int vn_off;
+    int tri_off;
+
+    int bad;    /* an index pointed outside of the file's data */
+};
+
+/**********
+ * corner *
+ **********/
+
+/* zero based indices of one face corner, -1 if the corner has none */
+
+struct corner {
+    int v;
+    int vt;
+    int vn;
+};
+
+/*************
+ * obj_parse *
+ *************/
+
+/* everything the threads share */
+
+struct obj_parse {
+    struct chunk* chunk;        /* the one a thread works on */
+
+    float* v;                   /* 3 per position */
+    float* vt;                  /* 2 per texture coordinate */
+    float* vn;                  /* 3 per normal */
+    struct corner* corners;     /* 3 per triangle */
+
+    int n_v;                    /* totals over all chunks */
+    int n_vt;
+    int n_vn;
+};
+
+/****************
+ * cache_header *
+ ****************/
+
+/**
+ * starts a cache file, followed by the points and then the indices 
+ * of every level of detail, the source's size and time tell if the 
+ * cache is still current
+ */
+
+struct cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_attr;
+    uint32_t n_pts;
+    uint32_t n_indices;         /* over all levels of detail */
+    uint64_t src_size;
+    int64_t src_mtime_sec;
+    int64_t src_mtime_nsec;
+    uint64_t pts_off;           /* bytes from the start of the file */
+    uint64_t indices_off;
+    float bounds[6];
+    uint32_t n_lods;
+    uint32_t pad;
+    struct sr_lod lods[SR_MAX_LODS];
+};
+
+/* points follow the header, keep them aligned for sse loads */
+_Static_assert(sizeof(struct cache_header) % 16 == 0, "cache alignment");
+
+/*********************************************************************
+ *                                                                   *
+ *                            scanning                               *
+ *                                                                   *
+ *********************************************************************/
+
+/************
+ * is_space *
+ ************/
+
+static inline int
+is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**************
+ * skip_space *
+ **************/
+
+static inline const char*
+skip_space(const char* p, const char* end)
+{
+    while (p < end && is_space(*p))
+        p++;
+    return p;
+}
+
+/*************
+ * next_line *
+ *************/
+
+/* start of the line after the one 'p' is in */
+static inline const char*
+next_line(const char* p, const char* end)
+{
+    const char* nl = memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+/***************
+ * parse_float *
+ ***************/
+
+/**
+ * reads a decimal float at 'p' and leaves 'p' after it, digits
+ * past the 19th only scale the result, which is plenty for meshes
+ */
+static float
+parse_float(const char** p, const char* end)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+        1e21, 1e22
+    };
+
+    const char* s = skip_space(*p, end);
+
+    int neg = 0;
+    if (s < end && (*s == '-' || *s == '+'))
+        neg = *s++ == '-';
+
+    uint64_t mant = 0;
+    int n_digits = 0;
+    int exp = 0;
+
+    for (; s < end && *s >= '0' && *s <= '9'; s++) {
+        if (n_digits < 19) {
+            mant = mant * 10 + (*s - '0');
+            if (mant)
+                n_digits++;
+        } else {
+            exp++;
+        }
+    }
+
+    if (s < end && *s == '.') {
+        for (s++; s < end && *s >= '0' && *s <= '9'; s++) {
+            if (n_digits < 19) {
+                mant = mant * 10 + (*s - '0');
+                if (mant)
+                    n_digits++;
+                exp--;
+            }
+        }
+    }
+
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        s++;
+        int exp_neg = 0;
+        if (s < end && (*s == '-' || *s == '+'))
+            exp_neg = *s++ == '-';
+        int e = 0;
+        for (; s < end && *s >= '0' && *s <= '9'; s++)
+            if (e < 1000)
+                e = e * 10 + (*s - '0');
+        exp += exp_neg ? -e : e;
+    }
+
+    *p = s;
+
+    double d = mant;
+    while (exp > 22) {
+        d *= 1e22;
+        exp -= 22;
+    }
+    while (exp < -22) {
+        d /= 1e22;
+        exp += 22;
+    }
+    d = exp < 0 ? d / pow10[-exp] : d * pow10[exp];
+
+    return neg ? -d : d;
+}
+
+/*************
+ * parse_int *
+ *************/
+
+/* reads a signed decimal int at 'p', 0 if there is none */
+static int
+parse_int(const char** p, const char* end)
+{
+    const char* s = *p;
+
+    int neg = 0;
+    if (s < end && (*s == '-' || *s == '+'))
+        neg = *s++ == '-';
+
+    int n = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; s++)
+        n = n * 10 + (*s - '0');
+
+    *p = s;
+    return neg ? -n : n;
+}
+
+/*****************
+ * resolve_index *
+ *****************/
+
+/**
+ * turns a one based or negative relative obj index into a zero
+ * based one given how many records came before, -1 if absent
+ */
+static inline int
+resolve_index(int i, int n_before, int n_total, int* bad)
+{
+    if (i == 0)
+        return -1;
+
+    int r = i > 0 ? i - 1 : n_before + i;
+    if (r < 0 || r >= n_total) {
+        *bad = 1;
+        return -1;
+    }
+    return r;
+}
+
+/****************
+ * parse_corner *
+ ****************/
+
+/* reads one v, v/vt, v//vn or v/vt/vn face corner */
+static void
+parse_corner(const char** p, const char* end, int* raw)
+{
+    raw[0] = parse_int(p, end);
+    raw[1] = 0;
+    raw[2] = 0;
+
+    if (*p < end && **p == '/') {
+        (*p)++;
+        raw[1] = parse_int(p, end);
+        if (*p < end && **p == '/') {
+            (*p)++;
+            raw[2] = parse_int(p, end);
+        }
+    }
+
+    while (*p < end && !is_space(**p) && **p != '\n')    /* junk */
+        (*p)++;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                         parallel passes                           *
+ *                                                                   *
+ *********************************************************************/
+
+/**************
+ * count_face *
+ **************/
+
+/* number of corners on the face line starting at 'p', up to any comment */
+static int
+count_face(const char* p, const char* end)
+{
+    int n = 0;
+    for (;;) {
+        p = skip_space(p, end);
+        if (p == end || *p == '\n' || *p == '#')
+            return n;
+        n++;
+        while (p < end && !is_space(*p) && *p != '\n')
+            p++;
+    }
+}
+
+/***************
+ * count_chunk *
+ ***************/
+
+/* first pass, tallies the records in a chunk so offsets can be assigned */
+static void*
+count_chunk(void* arg)
+{
+    struct chunk* c = arg;
+    const char* p = c->begin;
+
+    while (p < c->end) {
+        const char* s = skip_space(p, c->end);
+
+        if (c->end - s > 1) {
+            if (s[0] == 'v' && is_space(s[1]))
+                c->n_v++;
+            else if (s[0] == 'v' && s[1] == 't')
+                c->n_vt++;
+            else if (s[0] == 'v' && s[1] == 'n')
+                c->n_vn++;
+            else if (s[0] == 'f' && is_space(s[1])) {
+                int n = count_face(s + 1, c->end);
+                if (n >= 3)
+                    c->n_tris += n - 2;
+            }
+        }
+
+        p = next_line(s, c->end);
+    }
+
+    return 0;
+}
+
+/***************
+ * parse_chunk *
+ ***************/
+
+/**
+ * second pass, writes a chunk's positions, coordinates, normals
+ * and triangles at its offsets, polygons become triangle fans
+ */
+static void*
+parse_chunk(void* arg)
+{
+    struct obj_parse* op = arg;
+    struct chunk* c = op->chunk;
+
+    float* v = op->v + 3 * c->v_off;
+    float* vt = op->vt + 2 * c->vt_off;
+    float* vn = op->vn + 3 * c->vn_off;
+    struct corner* corners = op->corners + 3 * c->tri_off;
+
+    int n_v = c->v_off;      /* records seen so far, for relative indices */
+    int n_vt = c->vt_off;
+    int n_vn = c->vn_off;
+
+    const char* p = c->begin;
+    const char* end = c->end;
+
+    while (p < end) {
+        const char* s = skip_space(p, end);
+
+        if (end - s > 1 && s[0] == 'v' && is_space(s[1])) {
+            s++;
+            for (int i = 0; i < 3; i++)
+                *v++ = parse_float(&s, end);
+            n_v++;
+        } else if (end - s > 1 && s[0] == 'v' && s[1] == 't') {
+            s += 2;
+            for (int i = 0; i < 2; i++)
+                *vt++ = parse_float(&s, end);
+            n_vt++;
+        } else if (end - s > 1 && s[0] == 'v' && s[1] == 'n') {
+            s += 2;
+            for (int i = 0; i < 3; i++)
+                *vn++ = parse_float(&s, end);
+            n_vn++;
+        } else if (end - s > 1 && s[0] == 'f' && is_space(s[1])) {
+
+            struct corner first = {0}, prev = {0};
+            int n = 0;
+
+            s++;
+            for (;;) {
+                s = skip_space(s, end);
+                if (s == end || *s == '\n' || *s == '#')
+                    break;
+
+                int raw[3];
+                parse_corner(&s, end, raw);
+
+                struct corner cur = {
+                    .v = resolve_index(raw[0], n_v, op->n_v, &c->bad),
+                    .vt = resolve_index(raw[1], n_vt, op->n_vt, &c->bad),
+                    .vn = resolve_index(raw[2], n_vn, op->n_vn, &c->bad)
+                };
+                if (cur.v < 0)
+                    c->bad = 1;
+
+                if (n == 0) {
+                    first = cur;
+                } else if (n >= 2) {
+                    *corners++ = first;
+                    *corners++ = prev;
+                    *corners++ = cur;
+                }
+                prev = cur;
+                n++;
+            }
+        }
+
+        p = next_line(s, end);
+    }
+
+    return 0;
+}
+
+/**************
+ * run_chunks *
+ **************/
+
+/**
+ * runs 'pass' over every chunk, one thread each with the first on 
+ * the calling thread, 'pass' takes the chunk itself or, if 'shared', 
+ * a copy of 'op' pointing at the chunk
+ */
+static void
+run_chunks(void* (*pass)(void*), struct obj_parse* op,
+           struct chunk* chunks, int n_chunks, int shared)
+{
+    pthread_t threads[MAX_THREADS];
+    struct obj_parse ops[MAX_THREADS];
+    int started[MAX_THREADS] = {0};
+
+    for (int i = 0; i < n_chunks; i++) {
+        ops[i] = *op;
+        ops[i].chunk = chunks + i;
+    }
+
+    for (int i = n_chunks - 1; i >= 0; i--) {
+        void* arg = shared ? (void*)(ops + i) : (void*)(chunks + i);
+
+        /* this thread takes the first chunk and any that can't start */
+        if (i > 0 && pthread_create(threads + i, 0, pass, arg) == 0)
+            started[i] = 1;
+        else
+            pass(arg);
+    }
+
+    for (int i = 1; i < n_chunks; i++)
+        if (started[i])
+            pthread_join(threads[i], 0);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             dedup                                 *
+ *                                                                   *
+ *********************************************************************/
+
+/***************
+ * hash_corner *
+ ***************/
+
+static inline uint32_t
+hash_corner(struct corner* c)
+{
+    uint32_t h = (uint32_t)c->v * 0x9e3779b1u;
+    h ^= (uint32_t)c->vt * 0x85ebca77u + (h << 6) + (h >> 2);
+    h ^= (uint32_t)c->vn * 0xc2b2ae3du + (h << 6) + (h >> 2);
+    return h ^ (h >> 15);
+}
+
+/*****************
+ * build_indexed *
+ *****************/
+
+/**
+ * gives every distinct corner one point, with missing coordinates
+ * and normals left zero, and indexes the triangles into them, 
+ * boxing the positions on the way
+ */
+static int
+build_indexed(struct obj_parse* op, int n_tris, struct sr_obj* obj)
+{
+    int n_corners = 3 * n_tris;
+
+    int cap = 16;
+    while (cap < 2 * n_corners)
+        cap *= 2;
+
+    int* table = malloc(cap * sizeof(int));         /* point per slot */
+    struct corner* keys = malloc((n_corners + 1) * sizeof(struct corner));
+    obj->indices = malloc((n_corners + 1) * sizeof(int));
+    if (!table || !keys || !obj->indices) {
+        free(table);
+        free(keys);
+        return 0;
+    }
+    memset(table, -1, cap * sizeof(int));
+
+    int n_pts = 0;
+    for (int i = 0; i < n_corners; i++) {
+        struct corner* c = op->corners + i;
+        uint32_t slot = hash_corner(c) & (cap - 1);
+
+        for (;;) {
+            int pt = table[slot];
+            if (pt < 0) {
+                table[slot] = n_pts;
+                keys[n_pts] = *c;
+                obj->indices[i] = n_pts++;
+                break;
+            }
+            if (keys[pt].v == c->v && keys[pt].vt == c->vt &&
+                keys[pt].vn == c->vn) {
+                obj->indices[i] = pt;
+                break;
+            }
+            slot = (slot + 1) & (cap - 1);
+        }
+    }
+    free(table);
+
+    obj->pts = calloc((size_t)n_pts * OBJ_N_ATTR + 1, sizeof(float));
+    if (!obj->pts) {
+        free(keys);
+        return 0;
+    }
+
+    /* the bounding box grows as the points are filled */
+
+    float* lo = obj->bounds;
+    float* hi = obj->bounds + 3;
+    for (int k = 0; k < 3; k++) {
+        lo[k] = n_pts ? INFINITY : 0;
+        hi[k] = n_pts ? -INFINITY : 0;
+    }
+
+    for (int i = 0; i < n_pts; i++) {
+        float* pt = obj->pts + i * OBJ_N_ATTR;
+        memcpy(pt, op->v + 3 * keys[i].v, 3 * sizeof(float));
+        if (keys[i].vt >= 0)
+            memcpy(pt + 3, op->vt + 2 * keys[i].vt, 2 * sizeof(float));
+        if (keys[i].vn >= 0)
+            memcpy(pt + 5, op->vn + 3 * keys[i].vn, 3 * sizeof(float));
+
+        for (int k = 0; k < 3; k++) {
+            lo[k] = pt[k] < lo[k] ? pt[k] : lo[k];
+            hi[k] = pt[k] > hi[k] ? pt[k] : hi[k];
+        }
+    }
+    free(keys);
+
+    obj->n_pts = n_pts;
+    obj->n_attr = OBJ_N_ATTR;
+    obj->n_indices = n_corners;
+    obj->lods[0] = (struct sr_lod){0, n_corners, 0};
+    obj->n_lods = 1;
+
+    return 1;
+}
+
+/**************
+ * build_lods *
+ **************/
+
+/**
+ * simplifies each level into the next, a quarter its size, stopping 
+ * at SR_MAX_LODS, at MIN_LOD_TRIS or once simplification stalls, 
+ * every level's error adds up the errors of those before it, a mesh 
+ * that can't be simplified just keeps its one level
+ */
+static void
+build_lods(struct sr_obj* obj)
+{
+    int* indices;
+
+    while (obj->n_lods < SR_MAX_LODS) {
+
+        struct sr_lod* prev = obj->lods + obj->n_lods - 1;
+        int target = prev->n_indices / (3 * LOD_REDUCTION) * 3;
+        if (target < 3 * MIN_LOD_TRIS)
+            break;
+
+        /* a level stalled short of its target can be as big as the last */
+
+        int first = prev->first_index + prev->n_indices;
+        indices = realloc(obj->indices, (first + 
+                          (size_t)prev->n_indices + 1) * sizeof(int));
+        if (!indices)
+            break;
+        obj->indices = indices;
+
+        float error;
+        int n = sr_simplify(obj->indices + first, 
+                            obj->indices + prev->first_index, 
+                            prev->n_indices, obj->pts, obj->n_pts, 
+                            obj->n_attr, target, &error);
+
+        /* not worth a level if it didn't get much smaller */
+
+        if (n < 0 || n > prev->n_indices * 3 / 4)
+            break;
+
+        obj->lods[obj->n_lods++] = (struct sr_lod){
+            first, n, prev->error + error
+        };
+    }
+
+    struct sr_lod* last = obj->lods + obj->n_lods - 1;
+    indices = realloc(obj->indices, (last->first_index + 
+                      (size_t)last->n_indices + 1) * sizeof(int));
+    if (indices)
+        obj->indices = indices;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             whole file                            *
+ *                                                                   *
+ *********************************************************************/
+
+/***************
+ * split_lines *
+ ***************/
+
+/* cuts 'size' bytes into up to 'n' chunks that end at line breaks */
+static int
+split_lines(const char* data, size_t size, struct chunk* chunks, int n)
+{
+    const char* end = data + size;
+    const char* p = data;
+    int n_chunks = 0;
+
+    for (int i = 0; i < n && p < end; i++) {
+        const char* stop = i == n - 1 ? end : data + size * (i + 1) / n;
+        if (stop < p)
+            stop = p;
+        stop = stop < end ? next_line(stop, end) : end;
+
+        memset(chunks + n_chunks, 0, sizeof(struct chunk));
+        chunks[n_chunks].begin = p;
+        chunks[n_chunks].end = stop;
+        n_chunks++;
+        p = stop;
+    }
+
+    return n_chunks;
+}
+
+/****************
+ * parse_mapped *
+ ****************/
+
+/* parses a whole obj held in memory into 'obj' on up to 'n' threads */
+static int
+parse_mapped(const char* data, size_t size, int n, struct sr_obj* obj)
+{
+    struct chunk chunks[MAX_THREADS];
+    int n_chunks = split_lines(data, size, chunks, n);
+
+    struct obj_parse op = {0};
+
+    /* count, then give each chunk its place */
+
+    run_chunks(count_chunk, &op, chunks, n_chunks, 0);
+
+    int n_tris = 0;
+    for (int i = 0; i < n_chunks; i++) {
+        chunks[i].v_off = op.n_v;
+        chunks[i].vt_off = op.n_vt;
+        chunks[i].vn_off = op.n_vn;
+        chunks[i].tri_off = n_tris;
+        op.n_v += chunks[i].n_v;
+        op.n_vt += chunks[i].n_vt;
+        op.n_vn += chunks[i].n_vn;
+        n_tris += chunks[i].n_tris;
+    }
+
+    op.v = malloc((3 * (size_t)op.n_v + 1) * sizeof(float));
+    op.vt = malloc((2 * (size_t)op.n_vt + 1) * sizeof(float));
+    op.vn = malloc((3 * (size_t)op.n_vn + 1) * sizeof(float));
+    op.corners = malloc((3 * (size_t)n_tris + 1) * sizeof(struct corner));
+
+    int ok = op.v && op.vt && op.vn && op.corners;
+
+    /* parse in place */
+
+    if (ok) {
+        run_chunks(parse_chunk, &op, chunks, n_chunks, 1);
+        for (int i = 0; i < n_chunks; i++)
+            ok &= !chunks[i].bad;
+    }
+
+    if (ok)
+        ok = build_indexed(&op, n_tris, obj);
+    if (ok)
+        build_lods(obj);
+
+    free(op.v);
+    free(op.vt);
+    free(op.vn);
+    free(op.corners);
+
+    return ok;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                              cache                                *
+ *                                                                   *
+ *********************************************************************/
+
+/**************
+ * cache_path *
+ **************/
+
+/* the cache file that goes with 'file', must be freed */
+static char*
+cache_path(char* file)
+{
+    size_t len = strlen(file);
+    char* path = malloc(len + sizeof(CACHE_SUFFIX));
+    if (path) {
+        memcpy(path, file, len);
+        memcpy(path + len, CACHE_SUFFIX, sizeof(CACHE_SUFFIX));
+    }
+    return path;
+}
+
+/**************
+ * load_cache *
+ **************/
+
+/**
+ * maps the cache at 'path' if it was made from 'src' as it is now, 
+ * privately so the caller can write to the mesh, returns null if 
+ * the cache is missing, stale, of another layout or damaged
+ */
+static struct sr_obj*
+load_cache(char* path, struct stat* src)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || 
+        (size_t)st.st_size < sizeof(struct cache_header)) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = st.st_size;
+    void* map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    struct cache_header* h = map;
+    uint64_t pts_size = (uint64_t)h->n_pts * h->n_attr * sizeof(float);
+    uint64_t indices_size = (uint64_t)h->n_indices * sizeof(int);
+
+    int ok = memcmp(h->magic, CACHE_MAGIC, sizeof(h->magic)) == 0 &&
+             h->version == CACHE_VERSION &&
+             h->n_attr == OBJ_N_ATTR &&
+             h->src_size == (uint64_t)src->st_size &&
+             h->src_mtime_sec == (int64_t)src->st_mtim.tv_sec &&
+             h->src_mtime_nsec == (int64_t)src->st_mtim.tv_nsec &&
+             h->pts_off % 16 == 0 && h->indices_off % sizeof(int) == 0 &&
+             h->pts_off + pts_size <= size &&
+             h->indices_off + indices_size <= size &&
+             h->n_lods >= 1 && h->n_lods <= SR_MAX_LODS;
+
+    for (uint32_t i = 0; ok && i < h->n_lods; i++) {
+        struct sr_lod* lod = h->lods + i;
+        ok = lod->first_index >= 0 && lod->n_indices >= 0 &&
+             (uint64_t)lod->first_index + lod->n_indices <= h->n_indices;
+    }
+
+    /* a damaged index would be read out of bounds by every draw */
+
+    int* indices = ok ? (int*)((char*)map + h->indices_off) : 0;
+    for (uint32_t i = 0; ok && i < h->n_indices; i++)
+        ok = indices[i] >= 0 && (uint32_t)indices[i] < h->n_pts;
+
+    struct sr_obj* obj = ok ? calloc(1, sizeof(struct sr_obj)) : 0;
+    if (!obj) {
+        munmap(map, size);
+        return 0;
+    }
+
+    obj->pts = (float*)((char*)map + h->pts_off);
+    obj->n_pts = h->n_pts;
+    obj->n_attr = h->n_attr;
+    obj->indices = indices;
+    obj->n_indices = h->lods[0].n_indices;
+    memcpy(obj->lods, h->lods, sizeof(obj->lods));
+    obj->n_lods = h->n_lods;
+    memcpy(obj->bounds, h->bounds, sizeof(obj->bounds));
+    obj->map = map;
+    obj->map_size = size;
+
+    return obj;
+}
+
+/***************
+ * write_cache *
+ ***************/
+
+/**
+ * saves 'obj' as the cache at 'path', writing to a temporary file 
+ * renamed into place so concurrent loaders never see half a cache, 
+ * failing quietly since the cache only saves time
+ */
+static void
+write_cache(char* path, struct sr_obj* obj, struct stat* src)
+{
+    struct cache_header h;
+    memset(&h, 0, sizeof(h));
+
+    memcpy(h.magic, CACHE_MAGIC, sizeof(h.magic));
+    h.version = CACHE_VERSION;
+    h.n_attr = obj->n_attr;
+    h.n_pts = obj->n_pts;
+    struct sr_lod* last = obj->lods + obj->n_lods - 1;
+    h.n_indices = last->first_index + last->n_indices;
+    memcpy(h.bounds, obj->bounds, sizeof(h.bounds));
+    h.n_lods = obj->n_lods;
+    memcpy(h.lods, obj->lods, sizeof(h.lods));
+    h.src_size = src->st_size;
+    h.src_mtime_sec = src->st_mtim.tv_sec;
+    h.src_mtime_nsec = src->st_mtim.tv_nsec;
+    h.pts_off = sizeof(h);
+    h.indices_off = h.pts_off + 
+                    (uint64_t)obj->n_pts * obj->n_attr * sizeof(float);
+
+    size_t len = strlen(path);
+    char* tmp = malloc(len + 8);
+    if (!tmp)
+        return;
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".XXXXXX", 8);
+
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        free(tmp);
+        return;
+    }
+
+    FILE* f = fdopen(fd, "wb");
+    int ok = f != 0;
+    if (ok) {
+        ok = fwrite(&h, sizeof(h), 1, f) == 1;
+        ok = ok && fwrite(obj->pts, sizeof(float) * obj->n_attr, 
+                          obj->n_pts, f) == (size_t)obj->n_pts;
+        ok = ok && fwrite(obj->indices, sizeof(int), 
+                          h.n_indices, f) == (size_t)h.n_indices;
+        ok = fclose(f) == 0 && ok;
+    } else {
+        close(fd);
+    }
+
+    if (!ok || rename(tmp, path) != 0)
+        unlink(tmp);
+    free(tmp);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                            interface                              *
+ *                                                                   *
+ *********************************************************************/
+
+/***************
+ * sr_load_obj *
+ ***************/
+
+/**
+ * loads the triangles of an obj file as points of
+ * x, y, z, u, v, nx, ny, nz and an index list,
+ * from its cache if current, otherwise parsing it and writing one,
+ * returns null if the file can't be read or is malformed
+ */
+extern struct sr_obj*
+sr_load_obj(char* file)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    char* cache = cache_path(file);
+    struct sr_obj* cached = cache ? load_cache(cache, &st) : 0;
+    if (cached) {
+        close(fd);
+        free(cache);
+        return cached;
+    }
+
+    size_t size = st.st_size;
+    const char* data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        free(cache);
+        return 0;
+    }
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int n = size / MIN_CHUNK_SIZE + 1;
+    if (n > n_cpus)
+        n = n_cpus;
+    if (n > MAX_THREADS)
+        n = MAX_THREADS;
+    if (n < 1)
+        n = 1;
+
+    struct sr_obj* obj = calloc(1, sizeof(struct sr_obj));
+    if (obj && !parse_mapped(data, size, n, obj)) {
+        sr_obj_free(obj);
+        obj = 0;
+    }
+
+    munmap((void*)data, size);
+
+    if (obj && cache)
+        write_cache(cache, obj, &st);
+    free(cache);
+
+    return obj;
+}
+
+/***************
+ * sr_obj_free *
+ ***************/
+
+/* frees an obj from sr_load_obj */
+extern void
+sr_obj_free(struct sr_obj* obj)
+{
+    if (!obj)
+        return;
+    if (obj->map) {
+        munmap(obj->map, obj->map_size);
+    } else {
+        free(obj->pts);
+        free(obj->indices);
+    }
+    free(obj);
+}
@@ -0,0 +1,412 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sr.h"
+#include "sr_priv.h"
+
+/**
+ * occl.c
+ * --------
+ * software occlusion culling, a few large occluders are drawn
+ * depth only into a small buffer, then draws are tested by their
+ * bounding boxes against it before any of their vertex work
+ *
+ * the buffer holds eye depth (w) like the framebuffer's, but as a
+ * bound no nearer than any occluder point within each texel rather
+ * than the depth at its center, a box is hidden when every texel
+ * its screen rectangle touches is bounded nearer than the box's
+ * nearest corner
+ *
+ * a texel inside one triangle is bounded by that triangle alone, one
+ * split between an occluder's triangles by the farthest of them that
+ * touch it, but only if every edge crossing it joins two triangles
+ * lying either side of it on screen, an edge on the occluder's
+ * border, its silhouette or a slot through it leaves the texel open
+ *
+ */
+
+/*********************************************************************
+ *                                                                   *
+ *                      private declarations                         *
+ *                                                                   *
+ *********************************************************************/
+
+/****************
+ * sr_occlusion *
+ ****************/
+
+struct sr_occlusion {
+    float* depths;      /* farthest occluder point per texel, or infinity */
+    float* seams;       /* the occluder being drawn's, see draw_tr_depth */
+    uint8_t* opens;     /* 1 where one of its open edges may cross */
+    int width;
+    int height;
+};
+
+/*************
+ * occl_edge *
+ *************/
+
+struct occl_edge {
+    int lo;             /* the lesser point index of its ends */
+    int hi;
+    int corner;         /* 3 * triangle + the point across from it */
+};
+
+/*********************************************************************
+ *                                                                   *
+ *                       private definitions                         *
+ *                                                                   *
+ *********************************************************************/
+
+/****************
+ * to_occlusion *
+ ****************/
+
+/* moves a clip space point to the occlusion buffer's screen space */
+
+static void
+to_occlusion(struct sr_occlusion* occ, float* pt)
+{
+    pt[3] = 1 / pt[3];
+    pt[0] = (occ->width / 2.0f) * (pt[0] * pt[3] + 1);
+    pt[1] = (occ->height / 2.0f) * (1 - pt[1] * pt[3]);
+}
+
+/***************
+ * merge_seams *
+ ***************/
+
+/**
+ * bounds the texels an occluder touches and no open edge crosses by
+ * the farthest of its triangles there, then clears the seams for the
+ * next one, whose triangles say nothing of this one's gaps
+ */
+
+static void
+merge_seams(struct sr_occlusion* occ)
+{
+    size_t n = (size_t)occ->width * occ->height;
+
+    for (size_t i = 0; i < n; i++) {
+        if (occ->seams[i] > 0 && !occ->opens[i] &&
+            occ->seams[i] < occ->depths[i])
+            occ->depths[i] = occ->seams[i];
+        occ->seams[i] = 0;
+    }
+    memset(occ->opens, 0, n);
+}
+
+/*****************
+ * compare_edges *
+ *****************/
+
+/* by their ends, so the sides of one edge sort together */
+
+static int
+compare_edges(const void* a, const void* b)
+{
+    const struct occl_edge* ea = a;
+    const struct occl_edge* eb = b;
+
+    if (ea->lo != eb->lo)
+        return ea->lo - eb->lo;
+    return ea->hi - eb->hi;
+}
+
+/*******************
+ * find_open_edges *
+ *******************/
+
+/**
+ * sets in 'open' the edges of each triangle, bit k for the one across
+ * from its point k, that don't join it to exactly one other triangle
+ * lying on the far side of the edge on screen, with both wholly in
+ * front of the near plane and neither skipped as outside a plane
+ */
+
+static void
+find_open_edges(uint8_t* open, struct occl_edge* edges, float* screen,
+                uint8_t* flags, int* indices, int n_tris)
+{
+    for (int t = 0; t < n_tris; t++) {
+        open[t] = 7;
+        for (int k = 0; k < 3; k++) {
+            int a = indices[3 * t + (k + 1) % 3];
+            int b = indices[3 * t + (k + 2) % 3];
+            edges[3 * t + k] = (struct occl_edge){
+                a < b ? a : b, a < b ? b : a, 3 * t + k
+            };
+        }
+    }
+    qsort(edges, 3 * (size_t)n_tris, sizeof(*edges), compare_edges);
+
+    int n_edges = 3 * n_tris;
+    for (int i = 0; i < n_edges; ) {
+
+        int j = i + 1;
+        while (j < n_edges && !compare_edges(edges + i, edges + j))
+            j++;
+        if (j - i != 2) {
+            i = j;
+            continue;
+        }
+
+        int lo = edges[i].lo;
+        int hi = edges[i].hi;
+        int c0 = edges[i].corner;
+        int c1 = edges[i + 1].corner;
+        int p0 = indices[c0];
+        int p1 = indices[c1];
+        i = j;
+
+        if ((flags[lo] | flags[hi] | flags[p0] | flags[p1]) &
+            SR_CLIP_NEAR_PLANE)
+            continue;
+        if ((flags[lo] & flags[hi] & flags[p0]) ||
+            (flags[lo] & flags[hi] & flags[p1]))
+            continue;
+
+        /* the points across from the edge on either side of its line */
+
+        float* a = screen + 4 * lo;
+        float* b = screen + 4 * hi;
+        float* q0 = screen + 4 * p0;
+        float* q1 = screen + 4 * p1;
+        float s0 = (b[0] - a[0]) * (q0[1] - a[1]) -
+                   (b[1] - a[1]) * (q0[0] - a[0]);
+        float s1 = (b[0] - a[0]) * (q1[1] - a[1]) -
+                   (b[1] - a[1]) * (q1[0] - a[0]);
+
+        if ((s0 < 0 && s1 > 0) || (s0 > 0 && s1 < 0)) {
+            open[c0 / 3] &= ~(1 << c0 % 3);
+            open[c1 / 3] &= ~(1 << c1 % 3);
+        }
+    }
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                          internal interface                       *
+ *                                                                   *
+ *********************************************************************/
+
+/******************
+ * occlusion_draw *
+ ******************/
+
+/**
+ * draws the triangles of an occluder, whose positions are the first
+ * three attributes of 'pts', through 'mvp' into the buffer,
+ * clipping only against the planes the buffer's bounds don't cover,
+ * triangles meet only where they share point indices
+ */
+
+void
+occlusion_draw(struct sr_occlusion* occ, struct mat4* mvp,
+               float* pts, int n_pts, int n_attr,
+               int* indices, int n_indices)
+{
+    int n_tris = n_indices / 3;
+
+    float* clip = malloc((4 * (size_t)n_pts + 1) * sizeof(float));
+    float* screen = malloc((4 * (size_t)n_pts + 1) * sizeof(float));
+    uint8_t* flags = malloc(n_pts + 1);
+    uint8_t* open = malloc(n_tris + 1);
+    struct occl_edge* edges = malloc((3 * (size_t)n_tris + 1) *
+                                     sizeof(struct occl_edge));
+    if (!clip || !screen || !flags || !open || !edges) {
+        free(clip);
+        free(screen);
+        free(flags);
+        free(open);
+        free(edges);
+        return;
+    }
+
+    /* every point to clip space, w of 1 in place of later attributes */
+
+    for (int i = 0; i < n_pts; i++) {
+        memcpy(clip + 4 * i, pts + i * n_attr, 3 * sizeof(float));
+        clip[4 * i + 3] = 1;
+    }
+    vec4_matmul_n(clip, mvp, clip, n_pts, 4);
+    clip_test_batch(clip, n_pts, 4, flags);
+
+    /* which edges join triangles, from where the points land on screen */
+
+    memcpy(screen, clip, 4 * (size_t)n_pts * sizeof(float));
+    for (int i = 0; i < n_pts; i++)
+        to_occlusion(occ, screen + 4 * i);
+    find_open_edges(open, edges, screen, flags, indices, n_tris);
+
+    float poly[16 * 4];     /* room for a triangle clipped by 5 planes */
+
+    for (int t = 0; t < n_tris; t++) {
+
+        int* tri = indices + 3 * t;
+        uint8_t all = flags[tri[0]] & flags[tri[1]] & flags[tri[2]];
+        uint8_t any = flags[tri[0]] | flags[tri[1]] | flags[tri[2]];
+        if (all)
+            continue;
+
+        for (int k = 0; k < 3; k++)
+            memcpy(poly + 4 * k, clip + 4 * tri[k], 4 * sizeof(float));
+
+        int n = 3;
+        if (any & SR_CLIP_NEAR_PLANE)
+            clip_poly(poly, &n, 4, SR_CLIP_NEAR_PLANE);
+
+        for (int k = 0; k < n; k++)
+            to_occlusion(occ, poly + 4 * k);
+
+        /* a fan's diagonals lie inside the triangle, its sides are open */
+
+        for (int k = 1; k + 1 < n; k++) {
+            int fan = 1 | (k + 2 == n) << 1 | (k == 1) << 2;
+            draw_tr_depth(occ->depths, occ->seams, occ->opens,
+                          occ->width, occ->height, poly, poly + 4 * k,
+                          poly + 4 * (k + 1), open[t] & fan);
+        }
+    }
+    merge_seams(occ);
+
+    free(clip);
+    free(screen);
+    free(flags);
+    free(open);
+    free(edges);
+}
+
+/******************
+ * occlusion_test *
+ ******************/
+
+/**
+ * true if the model space box 'bounds', min x, y, z then max x, y,
+ * z, is hidden behind what the buffer holds, a box reaching the
+ * near plane or past the buffer's edges is never hidden
+ */
+
+int
+occlusion_test(struct sr_occlusion* occ, struct mat4* mvp, float* bounds)
+{
+    float corners[8 * 4];
+    for (int i = 0; i < 8; i++) {
+        corners[4 * i] = bounds[i & 1 ? 3 : 0];
+        corners[4 * i + 1] = bounds[i & 2 ? 4 : 1];
+        corners[4 * i + 2] = bounds[i & 4 ? 5 : 2];
+        corners[4 * i + 3] = 1;
+    }
+    vec4_matmul_n(corners, mvp, corners, 8, 4);
+
+    float min_x = INFINITY, min_y = INFINITY;
+    float max_x = -INFINITY, max_y = -INFINITY;
+    float nearest = INFINITY;
+
+    for (int i = 0; i < 8; i++) {
+        float* c = corners + 4 * i;
+        if (c[3] <= 0 || c[2] < -c[3])     /* reaches the near plane */
+            return 0;
+
+        nearest = fminf(nearest, c[3]);
+        to_occlusion(occ, c);
+        min_x = fminf(min_x, c[0]);
+        min_y = fminf(min_y, c[1]);
+        max_x = fmaxf(max_x, c[0]);
+        max_y = fmaxf(max_y, c[1]);
+    }
+
+    if (min_x < 0 || min_y < 0 || max_x > occ->width || max_y > occ->height)
+        return 0;
+
+    /* every texel the rectangle touches must be nearer */
+
+    int x0 = floorf(min_x);
+    int y0 = floorf(min_y);
+    int x1 = fminf(floorf(max_x), occ->width - 1);
+    int y1 = fminf(floorf(max_y), occ->height - 1);
+
+    for (int y = y0; y <= y1; y++) {
+        float* row = occ->depths + (size_t)y * occ->width;
+        for (int x = x0; x <= x1; x++) {
+            if (row[x] >= nearest)
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                         public definition                         *
+ *                                                                   *
+ *********************************************************************/
+
+/***********************
+ * sr_occlusion_create *
+ ***********************/
+
+/**
+ * makes an empty 'width' by 'height' occlusion buffer, a fraction
+ * of the framebuffer's size is plenty, returns null if out of memory
+ */
+
+extern struct sr_occlusion*
+sr_occlusion_create(int width, int height)
+{
+    struct sr_occlusion* occ = malloc(sizeof(struct sr_occlusion));
+    if (!occ)
+        return 0;
+
+    occ->depths = malloc((size_t)width * height * sizeof(float));
+    occ->seams = malloc((size_t)width * height * sizeof(float));
+    occ->opens = malloc((size_t)width * height);
+    if (!occ->depths || !occ->seams || !occ->opens) {
+        free(occ->depths);
+        free(occ->seams);
+        free(occ->opens);
+        free(occ);
+        return 0;
+    }
+
+    occ->width = width;
+    occ->height = height;
+    sr_occlusion_clear(occ);
+
+    return occ;
+}
+
+/*********************
+ * sr_occlusion_free *
+ *********************/
+
+extern void
+sr_occlusion_free(struct sr_occlusion* occ)
+{
+    if (!occ)
+        return;
+    free(occ->depths);
+    free(occ->seams);
+    free(occ->opens);
+    free(occ);
+}
+
+/**********************
+ * sr_occlusion_clear *
+ **********************/
+
+/* forgets every occluder, do this whenever the camera moves */
+
+extern void
+sr_occlusion_clear(struct sr_occlusion* occ)
+{
+    for (int i = 0; i < occ->width * occ->height; i++) {
+        occ->depths[i] = INFINITY;
+        occ->seams[i] = 0;
+    }
+    memset(occ->opens, 0, (size_t)occ->width * occ->height);
+}
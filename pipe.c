@@ -1,6 +1,11 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
 
 #include "sr.h"
 #include "rast.h"
@@ -14,6 +19,32 @@
  * 
  */
 
+/* number of primitives classified against the frustum at once */
+#define PRIM_BATCH 8
+
+/*********************************************************************
+ *                                                                   *
+ *                      private declarations                         *
+ *                                                                   *
+ *********************************************************************/
+
+/*************
+ * assembler *
+ *************/
+
+/* cursor through an index buffer, emits one primitive at a time */
+
+struct assembler {
+    int* indices;
+    int n_indices;
+    enum sr_primitive prim_type;
+    int prim_size;
+    int cur;        /* next index to read */
+    int win[3];     /* indices read since the last primitive or restart */
+    int n_win;
+    int odd;        /* strip triangles alternate their winding */
+};
+
 /*********************************************************************
  *                                                                   *
  *                       private definitions                         *
@@ -36,6 +67,23 @@ winding_order(int winding, float* v0, float* v1, float* v2)
     return (e01 + e12 + e20) * winding > 0;  /* same sign */
 }
 
+/*******************
+ * clip_space_area *
+ *******************/
+
+/**
+ * twice the signed ndc area of a triangle scaled by w0 * w1 * w2,
+ * read off the clip space coordinates without a perspective divide
+ */
+
+static float
+clip_space_area(float* v0, float* v1, float* v2)
+{
+    return v0[0] * (v1[1] * v2[3] - v2[1] * v1[3]) -
+           v1[0] * (v0[1] * v2[3] - v2[1] * v0[3]) +
+           v2[0] * (v0[1] * v1[3] - v1[1] * v0[3]);
+}
+
 /*************
  * draw_prim *
  *************/
@@ -54,14 +102,14 @@ draw_prim(struct raster_context* rast, float* pts,
             break;
 
         case SR_LINE_LIST:
-        case SR_LINE_STRIP:    /* line list */
-            for (int i = 1; i < n_pts; i++) {
-                /* draw_ln(rast, tmp_p, tmp_p + i * n_attr_out); */
-            }
+        case SR_LINE_STRIP:    /* one segment */
+            if (n_pts == 2)
+                draw_ln(rast, pts, pts + rast->n_attr);
             break;
 
         case SR_TRIANGLE_LIST:
-        case SR_TRIANGLE_STRIP:    /* triangle fan */
+        case SR_TRIANGLE_STRIP:
+        case SR_TRIANGLE_FAN:    /* clipped polygon as a fan */
             {
                 float* v0 = pts;
                 float* v1 = pts + 1 * rast->n_attr;
@@ -69,6 +117,8 @@ draw_prim(struct raster_context* rast, float* pts,
                     float* v2 = pts + i * rast->n_attr;
                     if (winding_order(rast->winding, v0, v1, v2))
                         draw_tr(rast, v0, v1, v2);
+                    else if (rast->stats)
+                        rast->stats->n_winding_culled++;
                     v1 = v2;
                 }
             }
@@ -76,6 +126,82 @@ draw_prim(struct raster_context* rast, float* pts,
     }
 }
 
+/************
+ * assemble *
+ ************/
+
+/**
+ * reads indices until the next complete primitive, writing its 
+ * vertex indices to 'prim', returns 0 once the buffer runs out
+ * 
+ * lists consume 'prim_size' fresh indices per primitive, strips 
+ * and fans reuse the previous ones, and a restart index drops any
+ * partial primitive and starts a new strip or fan
+ */
+
+static int
+assemble(struct assembler* as, int* prim)
+{
+    while (as->cur < as->n_indices) {
+
+        int idx = as->indices[as->cur++];
+
+        if (idx == SR_PRIMITIVE_RESTART) {
+            as->n_win = 0;
+            as->odd = 0;
+            continue;
+        }
+
+        switch (as->prim_type) {
+            case SR_POINT_LIST:
+            case SR_LINE_LIST:
+            case SR_TRIANGLE_LIST:
+                as->win[as->n_win++] = idx;
+                if (as->n_win == as->prim_size) {
+                    memcpy(prim, as->win, as->prim_size * sizeof(int));
+                    as->n_win = 0;
+                    return 1;
+                }
+                break;
+
+            case SR_LINE_STRIP:
+                if (as->n_win == 1) {
+                    prim[0] = as->win[0];
+                    prim[1] = idx;
+                    as->win[0] = idx;
+                    return 1;
+                }
+                as->win[as->n_win++] = idx;
+                break;
+
+            case SR_TRIANGLE_STRIP:
+                if (as->n_win == 2) {
+                    prim[0] = as->win[as->odd];    /* swap on odd */
+                    prim[1] = as->win[!as->odd];
+                    prim[2] = idx;
+                    as->win[0] = as->win[1];
+                    as->win[1] = idx;
+                    as->odd = !as->odd;
+                    return 1;
+                }
+                as->win[as->n_win++] = idx;
+                break;
+
+            case SR_TRIANGLE_FAN:
+                if (as->n_win == 2) {
+                    prim[0] = as->win[0];    /* hub */
+                    prim[1] = as->win[1];
+                    prim[2] = idx;
+                    as->win[1] = idx;
+                    return 1;
+                }
+                as->win[as->n_win++] = idx;
+                break;
+        }
+    }
+    return 0;
+}
+
 /**************
  * split_prim *
  **************/
@@ -97,11 +223,40 @@ split_prim(enum sr_primitive prim_type, int* prim_size)
             
         case SR_TRIANGLE_LIST:
         case SR_TRIANGLE_STRIP:
+        case SR_TRIANGLE_FAN:
             *prim_size = 3;
             break;
     }
 }
 
+/******************
+ * classify_prims *
+ ******************/
+
+/**
+ * folds the clip flags of each primitive in a batch into an 'and'
+ * (all points outside one plane) and an 'or' (crosses some plane)
+ */
+
+static void
+classify_prims(int* indices, int n_prims, int prim_size, 
+               uint8_t* clip_flags, uint8_t* clip_and, uint8_t* clip_or)
+{
+    for (int i = 0; i < n_prims; i++) {
+        clip_and[i] = 0xFF;
+        clip_or[i] = 0;
+    }
+
+    /* point-major so each pass is a straight sweep over the batch */
+    for (int j = 0; j < prim_size; j++) {
+        for (int i = 0; i < n_prims; i++) {
+            uint8_t flags = clip_flags[indices[i * prim_size + j]];
+            clip_and[i] &= flags;
+            clip_or[i] |= flags;
+        }
+    }
+}
+
 /****************
  * screen_space *
  ****************/
@@ -124,6 +279,292 @@ screen_space(struct sr_framebuffer* fbuf, float* pt)
     pt[2] = (pt[2] + 1) / 2;
 }
 
+/*************
+ * half_to_f *
+ *************/
+
+/* widens an ieee half precision float */
+
+static float
+half_to_f(uint16_t h)
+{
+#ifdef __F16C__
+    return _cvtsh_ss(h);
+#else
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t bits;
+
+    if (exp == 0x1f) {                      /* inf and nan */
+        bits = sign | 0x7f800000 | (mant << 13);
+    } else if (exp != 0) {                  /* normal */
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    } else if (mant == 0) {                 /* zero */
+        bits = sign;
+    } else {                                /* subnormal, renormalize */
+        exp = 113;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            exp--;
+        }
+        bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+#endif
+}
+
+/*****************
+ * decode_stream *
+ *****************/
+
+/* reads point 'i' of a stream into 'dest' as floats */
+
+static void
+decode_stream(struct sr_stream* stream, float* dest, int i)
+{
+    int stride = stream->stride ? stream->stride : stream->n_attr;
+
+    switch (stream->format) {
+        case SR_FORMAT_F16: {
+            uint16_t* src = (uint16_t*)stream->data + i * stride;
+            for (int j = 0; j < stream->n_attr; j++)
+                dest[j] = half_to_f(src[j]);
+            break;
+        }
+        case SR_FORMAT_SNORM16: {
+            int16_t* src = (int16_t*)stream->data + i * stride;
+            for (int j = 0; j < stream->n_attr; j++)
+                dest[j] = fmaxf(src[j] / 32767.0f, -1);
+            break;
+        }
+        case SR_FORMAT_UNORM16: {
+            uint16_t* src = (uint16_t*)stream->data + i * stride;
+            for (int j = 0; j < stream->n_attr; j++)
+                dest[j] = src[j] / 65535.0f;
+            break;
+        }
+        default:
+            memcpy(dest, (float*)stream->data + i * stride, 
+                   stream->n_attr * sizeof(float));
+    }
+}
+
+/****************
+ * fetch_vertex *
+ ****************/
+
+/**
+ * gathers and decodes point 'i' from the bound streams into 'dest', 
+ * or with no streams bound returns the interleaved point where it lies
+ */
+
+static float*
+fetch_vertex(struct sr_pipeline* pipe, float* dest, int i)
+{
+    if (pipe->n_streams == 0)
+        return pipe->pts_in + i * pipe->n_attr_in;
+
+    float* out = dest;
+    for (int s = 0; s < pipe->n_streams; s++) {
+        decode_stream(pipe->streams + s, out, i);
+        out += pipe->streams[s].n_attr;
+    }
+
+    return dest;
+}
+
+/*************
+ * shade_pts *
+ *************/
+
+/**
+ * runs the vertex shader over 'n_pts' input points starting at 
+ * 'first' and classifies the results against the frustum
+ */
+
+static void
+shade_pts(struct sr_pipeline* pipe, float* pts_out, 
+          uint8_t* clip_flags, int first, int n_pts)
+{
+    float pt_in[SR_MAX_ATTRIBUTE_COUNT];    /* gathered from streams */
+
+    for (int i = first; i < first + n_pts; i++) {    /* per point */
+
+        /* vertex shader pass */
+        pipe->vs(pts_out + i * pipe->n_attr_out,
+                 fetch_vertex(pipe, pt_in, i), 
+                 pipe->uniform);
+    }
+
+    /* classify every vertex against the frustum in one sweep */
+    clip_test_batch(pts_out + first * pipe->n_attr_out, n_pts, 
+                    pipe->n_attr_out, clip_flags + first);
+}
+
+/************
+ * draw_pts *
+ ************/
+
+/**
+ * assembles primitives from shaded points, culls and clips them, 
+ * then sends whatever survives to the rasterizer
+ */
+
+static void
+draw_pts(struct sr_pipeline* pipe, float* pts_out, uint8_t* clip_flags,
+         int* indices, int n_indices, enum sr_primitive prim_type, 
+         struct sr_stats* stats)
+{
+    struct raster_context rast = {
+        .fbuf = pipe->fbuf, 
+        .uniform = pipe->uniform, 
+        .fs = pipe->fs, 
+        .n_attr = pipe->n_attr_out,
+        .winding = pipe->winding,
+        .stats = stats
+    };
+
+    int prim_size = 0;
+    split_prim(prim_type, &prim_size);
+
+    struct assembler as = {
+        .indices = indices,
+        .n_indices = n_indices,
+        .prim_type = prim_type,
+        .prim_size = prim_size,
+        .cur = 0,
+        .n_win = 0,
+        .odd = 0
+    };
+
+    float tmp[16 * SR_MAX_ATTRIBUTE_COUNT]; /* holds current face */
+    int batch[PRIM_BATCH * 3];
+    uint8_t clip_and[PRIM_BATCH];
+    uint8_t clip_or[PRIM_BATCH];
+
+    for (;;) {
+
+        /* primitive assembly */
+
+        int n_batch = 0;
+        while (n_batch < PRIM_BATCH && 
+               assemble(&as, batch + n_batch * prim_size))
+            n_batch++;
+
+        if (n_batch == 0)
+            break;
+        stats->n_prims += n_batch;
+
+        /* trivial accept / reject for a batch of primitives */
+
+        classify_prims(batch, n_batch, prim_size, 
+                       clip_flags, clip_and, clip_or);
+
+        for (int j = 0; j < n_batch; j++) {
+
+            if (clip_and[j] != 0) {  /* outside frustum */
+                stats->n_frustum_culled++;
+                continue;
+            }
+
+            int* prim = batch + j * prim_size;
+
+            /* face culling */
+
+            if (prim_size == 3) {
+                float* v0 = pts_out + prim[0] * pipe->n_attr_out;
+                float* v1 = pts_out + prim[1] * pipe->n_attr_out;
+                float* v2 = pts_out + prim[2] * pipe->n_attr_out;
+
+                /* sign only holds in front of the eye, else wait for clip */
+                if (v0[3] > 0 && v1[3] > 0 && v2[3] > 0) {
+                    float area = clip_space_area(v0, v1, v2);
+                    if (area == 0) {
+                        stats->n_degenerate_culled++;
+                        continue;
+                    }
+                    if (area * pipe->winding < 0) {
+                        stats->n_backface_culled++;
+                        continue;
+                    }
+                }
+            }
+
+            /* gather primitive data */
+
+            for (int k = 0; k < prim_size; k++) {
+                memcpy(tmp + k * pipe->n_attr_out,
+                       pts_out + prim[k] * pipe->n_attr_out, 
+                       pipe->n_attr_out * sizeof(float));
+            }
+
+            /* clipping */
+
+            int clipped_prim_size = prim_size;
+            if (clip_or[j] != 0 && prim_size == 2)    /* line */
+                clip_line(tmp, &clipped_prim_size, 
+                          pipe->n_attr_out, clip_or[j]);
+            else if (clip_or[j] != 0)     /* if intersect frustum */
+                clip_poly(tmp, &clipped_prim_size, 
+                          pipe->n_attr_out, clip_or[j]);
+
+            /* perspective divide */
+            for (int k = 0; k < clipped_prim_size; k++)
+                screen_space(pipe->fbuf, tmp + k * pipe->n_attr_out);
+            
+            draw_prim(&rast, tmp, clipped_prim_size, prim_type);
+        }
+    }
+}
+
+/***************
+ * index_range *
+ ***************/
+
+/* smallest and largest index used, skipping restarts */
+
+static void
+index_range(int* indices, int n_indices, int* lo, int* hi)
+{
+    *lo = 0;
+    *hi = -1;    /* empty */
+
+    for (int i = 0; i < n_indices; i++) {
+        if (indices[i] == SR_PRIMITIVE_RESTART)
+            continue;
+        if (*hi < *lo) {
+            *lo = indices[i];
+            *hi = indices[i];
+        }
+        *lo = indices[i] < *lo ? indices[i] : *lo;
+        *hi = indices[i] > *hi ? indices[i] : *hi;
+    }
+}
+
+/***************
+ * merge_stats *
+ ***************/
+
+/* adds the counts from one render call to the pipeline's totals */
+
+static void
+merge_stats(struct sr_pipeline* pipe, struct sr_stats* stats)
+{
+    if (!pipe->stats)
+        return;
+
+    pipe->stats->n_prims += stats->n_prims;
+    pipe->stats->n_frustum_culled += stats->n_frustum_culled;
+    pipe->stats->n_degenerate_culled += stats->n_degenerate_culled;
+    pipe->stats->n_backface_culled += stats->n_backface_culled;
+    pipe->stats->n_winding_culled += stats->n_winding_culled;
+    pipe->stats->n_sample_culled += stats->n_sample_culled;
+}
+
 /*********************************************************************
  *                                                                   *
  *                         public definition                         *
@@ -143,19 +584,7 @@ void
 sr_render(struct sr_pipeline* pipe, int* indices, 
           int n_indices, enum sr_primitive prim_type)
 {
-    /* setup variables */
-    
-    struct raster_context rast = {
-        .fbuf = pipe->fbuf, 
-        .uniform = pipe->uniform, 
-        .fs = pipe->fs, 
-        .n_attr = pipe->n_attr_out,
-        .winding = pipe->winding
-    };
-
-    int prim_size = 0;
-    split_prim(prim_type, &prim_size);
-    int n_prims = n_indices / prim_size;
+    struct sr_stats stats = {0};
 
     /* vertex processing */
     
@@ -163,51 +592,159 @@ sr_render(struct sr_pipeline* pipe, int* indices,
                             sizeof(float));
     uint8_t* clip_flags = malloc(pipe->n_pts * sizeof(uint8_t));
 
-    for (int i = 0; i < pipe->n_pts; i++) {    /* per point */
+    shade_pts(pipe, pts_out, clip_flags, 0, pipe->n_pts);
 
-        /* vertex shader pass */
-        pipe->vs(pts_out + i * pipe->n_attr_out,
-                 pipe->pts_in + i * pipe->n_attr_in, 
-                 pipe->uniform);
+    /* primitive processing */
+
+    draw_pts(pipe, pts_out, clip_flags, indices, 
+             n_indices, prim_type, &stats);
+
+    free(pts_out);
+    free(clip_flags);
+
+    merge_stats(pipe, &stats);
+}
+
+/***********************
+ * sr_render_instanced *
+ ***********************/
+
+/**
+ * renders the same indexed vertex data 'n_instances' times, 
+ * calling 'instance' with the pipeline's uniform before each one so 
+ * it can set that instance's data there
+ * 
+ * the span of points the indices reach is found once, and every 
+ * instance shades just that span into one shared scratch buffer
+ */
+
+void
+sr_render_instanced(struct sr_pipeline* pipe, int* indices, 
+                    int n_indices, enum sr_primitive prim_type,
+                    int n_instances, inst_f instance)
+{
+    struct sr_stats stats = {0};
 
-        /* grab clip flags while vertex is still hot */
-        clip_test(pts_out + i * pipe->n_attr_out, clip_flags + i);
+    int lo, hi;
+    index_range(indices, n_indices, &lo, &hi);
+    if (hi < lo)
+        return;
+
+    float* pts_out = malloc(pipe->n_pts * pipe->n_attr_out * 
+                            sizeof(float));
+    uint8_t* clip_flags = malloc(pipe->n_pts * sizeof(uint8_t));
+
+    for (int i = 0; i < n_instances; i++) {
+        instance(pipe->uniform, i);
+        shade_pts(pipe, pts_out, clip_flags, lo, hi - lo + 1);
+        draw_pts(pipe, pts_out, clip_flags, indices, 
+                 n_indices, prim_type, &stats);
     }
 
-    float tmp[16 * SR_MAX_ATTRIBUTE_COUNT]; /* holds current face */
+    free(pts_out);
+    free(clip_flags);
 
-    for (int i = 0; i < n_prims * prim_size; i += prim_size) {
+    merge_stats(pipe, &stats);
+}
 
-        /* primitive assembly */
+/*******************
+ * sr_render_multi *
+ *******************/
 
-        uint8_t clip_and = 0, clip_or = 0;
+/**
+ * renders every draw record in 'draws' in order, each one a range
+ * of the shared index buffer 'indices' offset by its base vertex
+ * 
+ * scratch memory is allocated once for all of them, and each draw
+ * only shades the span of points its indices actually reach
+ */
 
-        for (int j = 0; j < prim_size; j++) {
-            /* fill buffer with primitive data */
-            memcpy(tmp + j * pipe->n_attr_out,
-                   pts_out + indices[i + j] * pipe->n_attr_out, 
-                   pipe->n_attr_out * sizeof(float));
+void
+sr_render_multi(struct sr_pipeline* pipe, int* indices, 
+                struct sr_draw* draws, int n_draws, 
+                enum sr_primitive prim_type)
+{
+    struct sr_stats stats = {0};
 
-            /* accumulate point clip flags */
-            clip_and &= clip_flags[indices[i + j]];
-            clip_or |= clip_flags[indices[i + j]];
-        }
+    float* pts_out = malloc(pipe->n_pts * pipe->n_attr_out * 
+                            sizeof(float));
+    uint8_t* clip_flags = malloc(pipe->n_pts * sizeof(uint8_t));
 
-        /* clipping */
+    for (int i = 0; i < n_draws; i++) {
 
-        if (clip_and != 0)  /* outside frustum */
+        struct sr_draw* draw = draws + i;
+        int* draw_indices = indices + draw->first_index;
+
+        struct sr_pipeline draw_pipe = *pipe;
+        if (draw->uniform)
+            draw_pipe.uniform = draw->uniform;
+
+        /* shade just the points this draw can reach */
+
+        int lo, hi;
+        index_range(draw_indices, draw->n_indices, &lo, &hi);
+        if (hi < lo)
             continue;
 
-        int clipped_prim_size = prim_size;
-        if (clip_or != 0)     /* if intersect frustum */
-            clip_poly(tmp, &clipped_prim_size, pipe->n_attr_out, clip_or);
+        shade_pts(&draw_pipe, pts_out, clip_flags, 
+                  draw->base_vertex + lo, hi - lo + 1);
+
+        /* offset the outputs so indices stay relative to the base */
 
-        /* perspective divide */
-        for (int j = 0; j < clipped_prim_size; j++)
-            screen_space(pipe->fbuf, tmp + j * pipe->n_attr_out);
-        
-        draw_prim(&rast, tmp, clipped_prim_size, prim_type);
+        draw_pts(&draw_pipe, 
+                 pts_out + draw->base_vertex * pipe->n_attr_out, 
+                 clip_flags + draw->base_vertex, 
+                 draw_indices, draw->n_indices, prim_type, &stats);
     }
+
     free(pts_out);
     free(clip_flags);
+
+    merge_stats(pipe, &stats);
+}
+
+/**************
+ * sr_resolve *
+ **************/
+
+/**
+ * averages each pixel's samples into 'colors', and keeps the nearest 
+ * in 'depths' if there is one, the channels of all samples are summed 
+ * at once in two 16 bit lanes each, which 8 samples can't overflow, 
+ * a count other than 2, 4 or 8 leaves the framebuffer as it is
+ */
+
+void
+sr_resolve(struct sr_framebuffer* fbuf)
+{
+    int n = fbuf->n_samples;
+    if (n <= 1 || n > SR_MAX_SAMPLES || n & (n - 1))
+        return;
+
+    int shift = __builtin_ctz(n);
+    uint32_t half = (n >> 1) * 0x00010001u;     /* rounds to nearest */
+    size_t n_pixels = (size_t)fbuf->width * fbuf->height;
+
+    for (size_t i = 0; i < n_pixels; i++) {
+
+        uint32_t* colors = fbuf->sample_colors + i * n;
+        uint32_t rb = half;
+        uint32_t ag = half;
+
+        for (int s = 0; s < n; s++) {
+            rb += colors[s] & 0x00ff00ff;
+            ag += (colors[s] >> 8) & 0x00ff00ff;
+        }
+
+        fbuf->colors[i] = ((rb >> shift) & 0x00ff00ff) | 
+                          ((ag >> shift) & 0x00ff00ff) << 8;
+
+        if (fbuf->depths) {
+            float* depths = fbuf->sample_depths + i * n;
+            float nearest = depths[0];
+            for (int s = 1; s < n; s++)
+                nearest = fminf(nearest, depths[s]);
+            fbuf->depths[i] = nearest;
+        }
+    }
 }
@@ -0,0 +1,491 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "sr.h"
+
+/**
+ * post.c
+ * --------
+ * post processing passes over a finished framebuffer
+ *
+ * fxaa finds edges by the contrast of luma around each pixel and
+ * blends across them, a first pass takes every pixel's luma and a
+ * copy of the colors to read from, a second tests contrast sixteen
+ * pixels at a time so only the few on an edge take the full walk
+ * along it, both passes split the rows between threads
+ *
+ */
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define MAX_THREADS 16
+#define MIN_BAND_ROWS 64        /* fewer rows per thread don't pay */
+
+#define EDGE_THRESHOLD_MIN 16   /* luma range ignored in the dark */
+#define EDGE_THRESHOLD_SHIFT 3  /* and below an eighth of the max */
+#define SUBPIX_QUALITY 0.75f    /* how much aliasing within a pixel blurs */
+
+/* how far each step along an edge reaches, farther the longer it runs */
+static const int search_steps[] = {1, 2, 3, 4, 6, 8, 12, 16, 24};
+
+#define N_SEARCH_STEPS (int)(sizeof(search_steps) / sizeof(int))
+
+/*********************************************************************
+ *                                                                   *
+ *                      private declarations                         *
+ *                                                                   *
+ *********************************************************************/
+
+/********
+ * band *
+ ********/
+
+/* the rows one thread works on, and what every thread shares */
+
+struct band {
+    struct sr_framebuffer* fbuf;
+    uint32_t* src;      /* the colors before the pass */
+    uint8_t* luma;
+    int y0;
+    int y1;             /* one past the last row */
+};
+
+/*********************************************************************
+ *                                                                   *
+ *                               luma                                *
+ *                                                                   *
+ *********************************************************************/
+
+/***********
+ * luma_of *
+ ***********/
+
+/* perceived brightness of an argb color, 0 to 255 */
+
+static inline uint8_t
+luma_of(uint32_t c)
+{
+    uint32_t r = (c >> 16) & 0xff;
+    uint32_t g = (c >> 8) & 0xff;
+    uint32_t b = c & 0xff;
+    return (r * 77 + g * 150 + b * 29) >> 8;
+}
+
+/************
+ * luma_row *
+ ************/
+
+/* the luma of 'n' colors */
+
+static void
+luma_row(uint8_t* dest, uint32_t* src, int n)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    /* 16 pixels per step, channels weighted in 16 bit lanes */
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i wr = _mm_set1_epi16(77);
+    const __m128i wg = _mm_set1_epi16(150);
+    const __m128i wb = _mm_set1_epi16(29);
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i lumas[2];
+        for (int h = 0; h < 2; h++) {
+            __m128i c0 = _mm_loadu_si128((__m128i*)(src + i + 8 * h));
+            __m128i c1 = _mm_loadu_si128((__m128i*)(src + i + 8 * h + 4));
+
+            __m128i r = _mm_packs_epi32(
+                _mm_and_si128(_mm_srli_epi32(c0, 16), mask),
+                _mm_and_si128(_mm_srli_epi32(c1, 16), mask));
+            __m128i g = _mm_packs_epi32(
+                _mm_and_si128(_mm_srli_epi32(c0, 8), mask),
+                _mm_and_si128(_mm_srli_epi32(c1, 8), mask));
+            __m128i b = _mm_packs_epi32(_mm_and_si128(c0, mask),
+                                        _mm_and_si128(c1, mask));
+
+            __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, wr),
+                                        _mm_mullo_epi16(g, wg));
+            sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, wb));
+            lumas[h] = _mm_srli_epi16(sum, 8);
+        }
+        _mm_storeu_si128((__m128i*)(dest + i),
+                         _mm_packus_epi16(lumas[0], lumas[1]));
+    }
+#endif
+
+    for (; i < n; i++)
+        dest[i] = luma_of(src[i]);
+}
+
+/*************
+ * luma_pass *
+ *************/
+
+/* fills in the luma of a band's rows and copies their colors */
+
+static void*
+luma_pass(void* arg)
+{
+    struct band* band = arg;
+    int width = band->fbuf->width;
+
+    for (int y = band->y0; y < band->y1; y++) {
+        size_t row = (size_t)y * width;
+        memcpy(band->src + row, band->fbuf->colors + row,
+               width * sizeof(uint32_t));
+        luma_row(band->luma + row, band->fbuf->colors + row, width);
+    }
+
+    return 0;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                               edges                               *
+ *                                                                   *
+ *********************************************************************/
+
+/***********
+ * is_edge *
+ ***********/
+
+/**
+ * true if the luma at 'x', 'y' and its four neighbours' span more
+ * than an eighth of their max and more than the dark minimum
+ */
+
+static inline int
+is_edge(uint8_t* luma, int width, int x, int y)
+{
+    uint8_t* m = luma + (size_t)y * width + x;
+    int hi = m[0];
+    int lo = m[0];
+    int around[4] = {m[-width], m[width], m[-1], m[1]};
+
+    for (int i = 0; i < 4; i++) {
+        hi = MAX(hi, around[i]);
+        lo = MIN(lo, around[i]);
+    }
+
+    int threshold = MAX(hi >> EDGE_THRESHOLD_SHIFT, EDGE_THRESHOLD_MIN - 1);
+
+    return hi - lo > threshold;
+}
+
+/*************
+ * edge_mask *
+ *************/
+
+/**
+ * is_edge for the 16 pixels from 'x' on row 'y' as a bit each, all
+ * of them in a few instructions
+ */
+
+static inline uint32_t
+edge_mask(uint8_t* luma, int width, int x, int y)
+{
+#ifdef __SSE2__
+    uint8_t* m = luma + (size_t)y * width + x;
+    __m128i c = _mm_loadu_si128((__m128i*)m);
+    __m128i n = _mm_loadu_si128((__m128i*)(m - width));
+    __m128i s = _mm_loadu_si128((__m128i*)(m + width));
+    __m128i w = _mm_loadu_si128((__m128i*)(m - 1));
+    __m128i e = _mm_loadu_si128((__m128i*)(m + 1));
+
+    __m128i hi = _mm_max_epu8(_mm_max_epu8(c, n),
+                              _mm_max_epu8(_mm_max_epu8(s, w), e));
+    __m128i lo = _mm_min_epu8(_mm_min_epu8(c, n),
+                              _mm_min_epu8(_mm_min_epu8(s, w), e));
+    __m128i range = _mm_subs_epu8(hi, lo);
+
+    /* the larger of max >> 3 and the minimum, per byte */
+    __m128i scaled = _mm_and_si128(_mm_srli_epi16(hi, EDGE_THRESHOLD_SHIFT),
+                                   _mm_set1_epi8(0xff >> EDGE_THRESHOLD_SHIFT));
+    __m128i threshold = _mm_max_epu8(scaled,
+                                     _mm_set1_epi8(EDGE_THRESHOLD_MIN - 1));
+
+    /* range > threshold where the saturating difference isn't zero */
+    __m128i flat = _mm_cmpeq_epi8(_mm_subs_epu8(range, threshold),
+                                  _mm_setzero_si128());
+    return ~_mm_movemask_epi8(flat) & 0xffff;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 16; i++)
+        mask |= (uint32_t)is_edge(luma, width, x + i, y) << i;
+    return mask;
+#endif
+}
+
+/*********
+ * blend *
+ *********/
+
+/* 'a' to 'b' by 't' from 0 to 256, two channels per multiply */
+
+static inline uint32_t
+blend(uint32_t a, uint32_t b, uint32_t t)
+{
+    uint32_t rb = ((a & 0x00ff00ff) * (256 - t) +
+                   (b & 0x00ff00ff) * t) >> 8;
+    uint32_t ag = ((a >> 8 & 0x00ff00ff) * (256 - t) +
+                   (b >> 8 & 0x00ff00ff) * t) >> 8;
+    return (rb & 0x00ff00ff) | (ag & 0x00ff00ff) << 8;
+}
+
+/*************
+ * walk_edge *
+ *************/
+
+/**
+ * steps from 'm' by 'along' until the sum of a luma and the one
+ * 'across' the edge from it differs from 'local' by half the
+ * gradient or more, or the walk would leave the frame after 'limit'
+ * pixels, returns the distance and sets 'end' to the difference
+ */
+
+static inline int
+walk_edge(uint8_t* m, int along, int across, int limit,
+          int local, int grad, int* end)
+{
+    int d = 1;
+    *end = 0;
+
+    for (int i = 0; i < N_SEARCH_STEPS; i++) {
+        d = search_steps[i];
+        if (d > limit) {
+            d = limit + 1;
+            break;
+        }
+
+        uint8_t* p = m + d * along;
+        *end = p[0] + p[across] - local;
+        if (2 * abs(*end) >= grad)
+            return d;
+    }
+
+    return d + 1;
+}
+
+/**************
+ * fxaa_pixel *
+ **************/
+
+/**
+ * the color of an edge pixel blended toward its neighbour across
+ * the edge, by how near it sits to the end of the edge's stair step,
+ * or by how much it stands out from its neighbours if that's more
+ */
+
+static uint32_t
+fxaa_pixel(struct band* band, int x, int y)
+{
+    int width = band->fbuf->width;
+    int height = band->fbuf->height;
+    uint8_t* m = band->luma + (size_t)y * width + x;
+
+    int l_m = m[0];
+    int l_n = m[-width];
+    int l_s = m[width];
+    int l_w = m[-1];
+    int l_e = m[1];
+    int l_nw = m[-width - 1];
+    int l_ne = m[-width + 1];
+    int l_sw = m[width - 1];
+    int l_se = m[width + 1];
+
+    int hi = MAX(l_m, MAX(MAX(l_n, l_s), MAX(l_w, l_e)));
+    int lo = MIN(l_m, MIN(MIN(l_n, l_s), MIN(l_w, l_e)));
+
+    /* a pixel standing out on its own blends by itself */
+
+    int l_sum = 2 * (l_n + l_s + l_w + l_e) + l_nw + l_ne + l_sw + l_se;
+    float sub = MIN(abs(l_sum - 12 * l_m) / (12.0f * (hi - lo)), 1);
+    sub = (-2 * sub + 3) * sub * sub;
+    float sub_offset = sub * sub * SUBPIX_QUALITY;
+
+    /* which way the edge runs */
+
+    int horz = abs(l_nw + l_sw - 2 * l_w) +
+               2 * abs(l_n + l_s - 2 * l_m) +
+               abs(l_ne + l_se - 2 * l_e);
+    int vert = abs(l_nw + l_ne - 2 * l_n) +
+               2 * abs(l_w + l_e - 2 * l_m) +
+               abs(l_sw + l_se - 2 * l_s);
+    int is_horz = horz >= vert;
+
+    /* the side of the pixel the edge lies on, up or left if negative */
+
+    int l_neg = is_horz ? l_n : l_w;
+    int l_pos = is_horz ? l_s : l_e;
+    int grad_neg = abs(l_neg - l_m);
+    int grad_pos = abs(l_pos - l_m);
+
+    int side = grad_neg >= grad_pos ? -1 : 1;
+    int grad = MAX(grad_neg, grad_pos);
+    int l_local = (side < 0 ? l_neg : l_pos) + l_m;     /* doubled */
+
+    /* walk both ways along the edge until the pair average changes */
+
+    int along = is_horz ? 1 : width;
+    int across = is_horz ? side * width : side;
+
+    int end_neg;
+    int end_pos;
+    int d_neg = walk_edge(m, -along, across, is_horz ? x : y,
+                          l_local, grad, &end_neg);
+    int d_pos = walk_edge(m, along, across,
+                          is_horz ? width - 1 - x : height - 1 - y,
+                          l_local, grad, &end_pos);
+
+    /* blend only on the side of the step that belongs to the far end */
+
+    int near_end = d_neg < d_pos ? end_neg : end_pos;
+    float edge_offset = 0;
+    if ((2 * l_m - l_local < 0) != (near_end < 0))
+        edge_offset = 0.5f - MIN(d_neg, d_pos) / (float)(d_neg + d_pos);
+
+    float offset = MAX(edge_offset, sub_offset);
+    size_t i = (size_t)y * width + x;
+
+    return blend(band->src[i], band->src[i + across], offset * 256);
+}
+
+/*************
+ * edge_pass *
+ *************/
+
+/**
+ * blends every edge pixel of a band's rows in the framebuffer,
+ * reading only the copy, the outermost pixels are left as they are
+ */
+
+static void*
+edge_pass(void* arg)
+{
+    struct band* band = arg;
+    int width = band->fbuf->width;
+    int height = band->fbuf->height;
+
+    int y0 = MAX(band->y0, 1);
+    int y1 = MIN(band->y1, height - 1);
+
+    for (int y = y0; y < y1; y++) {
+        uint32_t* colors = band->fbuf->colors + (size_t)y * width;
+
+        int x = 1;
+        for (; x + 16 <= width - 1; x += 16) {
+            uint32_t mask = edge_mask(band->luma, width, x, y);
+            while (mask) {
+                int i = __builtin_ctz(mask);
+                colors[x + i] = fxaa_pixel(band, x + i, y);
+                mask &= mask - 1;
+            }
+        }
+
+        /* what's left of the row a pixel at a time */
+
+        for (; x < width - 1; x++) {
+            if (is_edge(band->luma, width, x, y))
+                colors[x] = fxaa_pixel(band, x, y);
+        }
+    }
+
+    return 0;
+}
+
+/*************
+ * run_bands *
+ *************/
+
+/* runs 'pass' over every band, the first on the calling thread */
+
+static void
+run_bands(void* (*pass)(void*), struct band* bands, int n_bands)
+{
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS] = {0};
+
+    for (int i = n_bands - 1; i >= 0; i--) {
+        if (i > 0 && pthread_create(threads + i, 0, pass, bands + i) == 0)
+            started[i] = 1;
+        else
+            pass(bands + i);
+    }
+
+    for (int i = 1; i < n_bands; i++)
+        if (started[i])
+            pthread_join(threads[i], 0);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                         public definition                         *
+ *                                                                   *
+ *********************************************************************/
+
+/***********
+ * sr_fxaa *
+ ***********/
+
+/**
+ * smooths the edges in the framebuffer's colors, in place, as fast
+ * approximate anti-aliasing does, at a fraction of multisampling's
+ * cost but blurring some texture detail along with them
+ *
+ * returns 0 if out of memory, leaving the colors untouched
+ */
+
+extern int
+sr_fxaa(struct sr_framebuffer* fbuf)
+{
+    int width = fbuf->width;
+    int height = fbuf->height;
+    size_t n_pixels = (size_t)width * height;
+
+    struct band bands[MAX_THREADS];
+    uint32_t* src = malloc(n_pixels * sizeof(uint32_t) + 1);
+    uint8_t* luma = malloc(n_pixels + 1);
+    if (!src || !luma) {
+        free(src);
+        free(luma);
+        return 0;
+    }
+
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int n = height / MIN_BAND_ROWS;
+    if (n > n_cpus)
+        n = n_cpus;
+    if (n > MAX_THREADS)
+        n = MAX_THREADS;
+    if (n < 1)
+        n = 1;
+
+    for (int i = 0; i < n; i++) {
+        bands[i] = (struct band){
+            .fbuf = fbuf,
+            .src = src,
+            .luma = luma,
+            .y0 = height * i / n,
+            .y1 = height * (i + 1) / n
+        };
+    }
+
+    /* every row's luma before any row looks at its neighbours */
+
+    run_bands(luma_pass, bands, n);
+    run_bands(edge_pass, bands, n);
+
+    free(src);
+    free(luma);
+    return 1;
+}
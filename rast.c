@@ -10,7 +10,27 @@
  * --------
  * rasterizes triangles, lines, and points
  * 
+ * with several samples per pixel, triangles test coverage and depth 
+ * at every sample but shade once per pixel, the color lands in each 
+ * sample that passed, so edges smooth out at the cost of memory only
+ * 
+ */
+
+/* slack when deciding a triangle's bounds hold no pixel center */
+#define SAMPLE_EPSILON (1.0 / 1024)
+
+/**
+ * sample positions from the pixel center in sixteenths of a pixel, 
+ * the usual rotated patterns for 1, 2, 4 and 8 samples, indexed by 
+ * the log of the count
  */
+static const float sample_patterns[4][SR_MAX_SAMPLES][2] = {
+    {{0, 0}},
+    {{4, 4}, {-4, -4}},
+    {{-2, -6}, {6, -2}, {-6, 2}, {2, 6}},
+    {{1, -3}, {-1, 3}, {5, 1}, {-3, -5}, 
+     {-5, 5}, {-7, -1}, {3, 7}, {7, -7}}
+};
 
 /*********************************************************************
  *                                                                   *
@@ -66,6 +86,79 @@ is_tl(float* v0, float* v1)
     return is_top | is_left;
 }
 
+/**********
+ * inside *
+ **********/
+
+/* tests barycentric weights against the top left fill rule */
+
+static int
+inside(float w0, float w1, float w2, 
+       struct edge* e12, struct edge* e20, struct edge* e01)
+{
+    float f0 = (w0 == 0) && !e12->is_tl ? -1 : 0;
+    float f1 = (w1 == 0) && !e20->is_tl ? -1 : 0;
+    float f2 = (w2 == 0) && !e01->is_tl ? -1 : 0;
+
+    return (w0 + f0 >= 0) && (w1 + f1 >= 0) && (w2 + f2 >= 0);
+}
+
+/***************
+ * interpolate *
+ ***************/
+
+/**
+ * interpolates the triangle's attributes perspective correctly
+ * at 'pt' from its barycentric weights
+ */
+
+static void
+interpolate(struct raster_context* rast, float* pt, 
+            float* v0, float* v1, float* v2, 
+            float w0, float w1, float w2)
+{
+    /* normalize barycentric weights */
+
+    float area = w0 + w1 + w2;
+    
+    float b0 = w0 / area;
+    float b1 = w1 / area;
+    float b2 = w2 / area;
+
+    /* interpolate z and w */
+
+    float a = b0 * v0[3];
+    float b = b1 * v1[3];
+    float c = b2 * v2[3];
+
+    float Z = a + b + c;
+
+    pt[2] = 1 / Z;
+    pt[3] = Z;
+
+    /* interpolate rest of points */
+
+    for (int i = 4; i < (int)rast->n_attr; i++) {
+        float P = (a * v0[i] + b * v1[i] + c * v2[i]);
+        pt[i] = P * pt[2]; /* to clip space */
+    }
+}
+
+/****************
+ * shade_sample *
+ ****************/
+
+/* interpolates the triangle at 'pt', then shades it */
+
+static void
+shade_sample(struct raster_context* rast, float* pt, 
+             float* v0, float* v1, float* v2, 
+             float w0, float w1, float w2)
+{
+    interpolate(rast, pt, v0, v1, v2, w0, w1, w2);
+    draw_pt(rast, pt);
+}
+
 /*********************************************************************
  *                                                                   *
  *                       private constructors                        *
@@ -104,9 +197,12 @@ edge_init(struct edge* edge, int winding,
  * bbox_init *
  *************/
 
-/* define a pixel-aligned bounding box for triangle rasterization */
+/**
+ * define a pixel-aligned bounding box for triangle rasterization,
+ * returns 0 when no pixel center falls within the triangle's bounds
+ */
 
-static void
+static int
 bbox_init(struct bbox* bbox, float* v0, float* v1, float* v2)
 {    
     /* naiive values */
@@ -116,12 +212,161 @@ bbox_init(struct bbox* bbox, float* v0, float* v1, float* v2)
     bbox->max_x = fmax(v0[0], fmax(v1[0], v2[0]));
     bbox->max_y = fmax(v0[1], fmax(v1[1], v2[1]));
 
+    /* first and last pixel centers inside, padded against rounding */
+
+    int has_x = ceilf(bbox->min_x - 0.5 - SAMPLE_EPSILON) <= 
+                floorf(bbox->max_x - 0.5 + SAMPLE_EPSILON);
+    int has_y = ceilf(bbox->min_y - 0.5 - SAMPLE_EPSILON) <= 
+                floorf(bbox->max_y - 0.5 + SAMPLE_EPSILON);
+
     /* align to pixel centers */
 
     bbox->min_x = floorf(bbox->min_x) + 0.5;
     bbox->min_y = floorf(bbox->min_y) + 0.5;
     bbox->max_x = floorf(bbox->max_x) + 0.5;
     bbox->max_y = floorf(bbox->max_y) + 0.5;
+
+    return has_x && has_y;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                          multisampling                            *
+ *                                                                   *
+ *********************************************************************/
+
+/****************
+ * draw_tr_msaa *
+ ****************/
+
+/**
+ * rasterizes a triangle into the framebuffer's samples, each pixel 
+ * steps its edge functions once and offsets them to every sample, 
+ * samples that are covered and pass their own depth test take one 
+ * color, shaded at the pixel center, or at the first covered sample 
+ * if the center lies outside so attributes never extrapolate, 
+ * nothing is drawn for a count with no pattern
+ */
+
+static void
+draw_tr_msaa(struct raster_context* rast, float* v0, float* v1, float* v2)
+{
+    struct sr_framebuffer* fbuf = rast->fbuf;
+    int n = fbuf->n_samples;
+    if (n > SR_MAX_SAMPLES || n & (n - 1))
+        return;
+
+    const float (*offsets)[2] = sample_patterns[__builtin_ctz(n)];
+
+    /* every pixel a sample could fall in, kept inside the buffer */
+
+    int x0 = fmaxf(floorf(fminf(v0[0], fminf(v1[0], v2[0]))), 0);
+    int y0 = fmaxf(floorf(fminf(v0[1], fminf(v1[1], v2[1]))), 0);
+    int x1 = fminf(floorf(fmaxf(v0[0], fmaxf(v1[0], v2[0]))), 
+                   fbuf->width - 1);
+    int y1 = fminf(floorf(fmaxf(v0[1], fmaxf(v1[1], v2[1]))), 
+                   fbuf->height - 1);
+
+    float pt[SR_MAX_ATTRIBUTE_COUNT];
+    pt[0] = x0 + 0.5f;
+    pt[1] = y0 + 0.5f;
+
+    struct edge e12, e20, e01;
+
+    float w0_row = edge_init(&e12, rast->winding, v1, v2, pt);
+    float w1_row = edge_init(&e20, rast->winding, v2, v0, pt);
+    float w2_row = edge_init(&e01, rast->winding, v0, v1, pt);
+
+    /* the weights sum to twice the area everywhere */
+
+    float area = w0_row + w1_row + w2_row;
+    if (area <= 0)
+        return;
+
+    /* how far each sample moves the weights from the center */
+
+    float d0[SR_MAX_SAMPLES];
+    float d1[SR_MAX_SAMPLES];
+    float d2[SR_MAX_SAMPLES];
+
+    for (int s = 0; s < n; s++) {
+        float dx = offsets[s][0] / 16;
+        float dy = offsets[s][1] / 16;
+        d0[s] = dx * e12.step_x + dy * e12.step_y;
+        d1[s] = dx * e20.step_x + dy * e20.step_y;
+        d2[s] = dx * e01.step_x + dy * e01.step_y;
+    }
+
+    int covered = 0;
+    float depths[SR_MAX_SAMPLES];
+
+    for (int y = y0; y <= y1; y++) {
+
+        float w0 = w0_row;
+        float w1 = w1_row;
+        float w2 = w2_row;
+
+        for (int x = x0; x <= x1; x++) {
+
+            size_t idx = ((size_t)y * fbuf->width + x) * n;
+            float* sample_depths = fbuf->sample_depths + idx;
+
+            /* coverage and depth at every sample */
+
+            int first = -1;
+            uint32_t mask = 0;
+
+            for (int s = 0; s < n; s++) {
+                float s0 = w0 + d0[s];
+                float s1 = w1 + d1[s];
+                float s2 = w2 + d2[s];
+                if (!inside(s0, s1, s2, &e12, &e20, &e01))
+                    continue;
+                if (first < 0)
+                    first = s;
+
+                depths[s] = area / (s0 * v0[3] + s1 * v1[3] + s2 * v2[3]);
+                if (depths[s] < sample_depths[s])
+                    mask |= 1u << s;
+            }
+
+            covered |= first >= 0;
+
+            /* one shade for every sample that passed */
+
+            if (mask) {
+                int center = inside(w0, w1, w2, &e12, &e20, &e01);
+                pt[0] = x + 0.5f;
+                pt[1] = y + 0.5f;
+                interpolate(rast, pt, v0, v1, v2, 
+                            center ? w0 : w0 + d0[first], 
+                            center ? w1 : w1 + d1[first], 
+                            center ? w2 : w2 + d2[first]);
+
+                uint32_t color = 0;
+                rast->fs(&color, pt, rast->uniform);
+
+                uint32_t* sample_colors = fbuf->sample_colors + idx;
+                for (int s = 0; s < n; s++) {
+                    if (mask & (1u << s)) {
+                        sample_colors[s] = color;
+                        sample_depths[s] = depths[s];
+                    }
+                }
+            }
+
+            w0 += e12.step_x;
+            w1 += e20.step_x;
+            w2 += e01.step_x;
+        }
+
+        w0_row += e12.step_y;
+        w1_row += e20.step_y;
+        w2_row += e01.step_y;
+    }
+
+    if (!covered && rast->stats)
+        rast->stats->n_sample_culled++;
 }
 
 /*********************************************************************
@@ -134,7 +379,10 @@ bbox_init(struct bbox* bbox, float* v0, float* v1, float* v2)
  * draw_pt *
  ***********/
 
-/* render point to framebuffer */
+/**
+ * render point to framebuffer, into every sample of its pixel that 
+ * it's nearer than when multisampling
+ */
 
 void 
 draw_pt(struct raster_context* rast, float* pt)
@@ -142,6 +390,19 @@ draw_pt(struct raster_context* rast, float* pt)
     uint32_t color = 0; /* color dest */
     rast->fs(&color, pt, rast->uniform);  /* fragment shader */
     size_t fbuf_idx = floorf(pt[1]) * rast->fbuf->width + floorf(pt[0]);
+
+    int n = rast->fbuf->n_samples;
+    if (n > 1) {
+        uint32_t* colors = rast->fbuf->sample_colors + fbuf_idx * n;
+        float* depths = rast->fbuf->sample_depths + fbuf_idx * n;
+        for (int s = 0; s < n; s++) {
+            if (pt[2] < depths[s]) {
+                colors[s] = color;
+                depths[s] = pt[2];
+            }
+        }
+        return;
+    }
     
     if (pt[2] < rast->fbuf->depths[fbuf_idx]) {  /* depth buffer */
         rast->fbuf->colors[fbuf_idx] = color;
@@ -149,6 +410,91 @@ draw_pt(struct raster_context* rast, float* pt)
     }
 }
 
+/***********
+ * draw_ln *
+ ***********/
+
+/**
+ * rasterize a line to framebuffer with a dda, one pixel per center
+ * crossed along the major axis, half open so that segments meeting 
+ * end to end along it don't both draw the shared pixel
+ * 
+ * depth and attributes interpolate perspective correctly, all of 
+ * them are linear in screen space once weighted by 1 / w so they 
+ * step along with the minor axis
+ */
+
+void
+draw_ln(struct raster_context* rast, float* v0, float* v1)
+{
+    float dx = v1[0] - v0[0];
+    float dy = v1[1] - v0[1];
+
+    int major = fabsf(dx) >= fabsf(dy) ? 0 : 1;
+    int minor = !major;
+
+    /* walk the major axis forwards */
+
+    if (v1[major] < v0[major]) {
+        float* tmp = v0;
+        v0 = v1;
+        v1 = tmp;
+    }
+
+    float len = v1[major] - v0[major];
+    if (len == 0)
+        return;
+
+    /* pixel centers crossed, kept inside the framebuffer */
+
+    int dims[2] = { rast->fbuf->width, rast->fbuf->height };
+
+    float start = fmaxf(ceilf(v0[major] - 0.5) + 0.5, 0.5);
+    float end = fminf(ceilf(v1[major] - 0.5) - 0.5, dims[major] - 0.5);
+
+    /* per step increments */
+
+    float slope = (v1[minor] - v0[minor]) / len;
+    float dZ = (v1[3] - v0[3]) / len;
+
+    float dP[SR_MAX_ATTRIBUTE_COUNT];
+    for (int i = 4; i < rast->n_attr; i++)
+        dP[i] = (v1[3] * v1[i] - v0[3] * v0[i]) / len;
+
+    /* values at the first center */
+
+    float t = start - v0[major];
+    float pos = v0[minor] + slope * t;
+    float Z = v0[3] + dZ * t;
+
+    float P[SR_MAX_ATTRIBUTE_COUNT];
+    for (int i = 4; i < rast->n_attr; i++)
+        P[i] = v0[3] * v0[i] + dP[i] * t;
+
+    float pt[SR_MAX_ATTRIBUTE_COUNT];
+
+    for (pt[major] = start; pt[major] <= end; pt[major]++) {
+
+        pt[minor] = floorf(pos) + 0.5;
+
+        if (pt[minor] > 0 && pt[minor] < dims[minor]) {
+
+            pt[2] = 1 / Z;
+            pt[3] = Z;
+
+            for (int i = 4; i < rast->n_attr; i++)
+                pt[i] = P[i] * pt[2];    /* to clip space */
+
+            draw_pt(rast, pt);
+        }
+
+        pos += slope;
+        Z += dZ;
+        for (int i = 4; i < rast->n_attr; i++)
+            P[i] += dP[i];
+    }
+}
+
 /***********
  * draw_tr *
  ***********/
@@ -158,10 +504,22 @@ draw_pt(struct raster_context* rast, float* pt)
 void 
 draw_tr(struct raster_context* rast, float* v0, float* v1, float* v2)
 {   
+    if (rast->fbuf->n_samples > 1) {
+        draw_tr_msaa(rast, v0, v1, v2);
+        return;
+    }
+
     /* find bounding box */
 
     struct bbox bbox; 
-    bbox_init(&bbox, v0, v1, v2);
+
+    /* no pixel center inside the bounds, nothing can be covered */
+
+    if (!bbox_init(&bbox, v0, v1, v2)) {
+        if (rast->stats)
+            rast->stats->n_sample_culled++;
+        return;
+    }
 
     /* store current point */
 
@@ -187,48 +545,114 @@ draw_tr(struct raster_context* rast, float* v0, float* v1, float* v2)
 
         for (pt[0] = bbox.min_x; pt[0] <= bbox.max_x; pt[0]++) {
 
-            float f0 = (w0 == 0) && !e12.is_tl ? -1 : 0;
-            float f1 = (w1 == 0) && !e20.is_tl ? -1 : 0;
-            float f2 = (w2 == 0) && !e01.is_tl ? -1 : 0;
+            if (inside(w0, w1, w2, &e12, &e20, &e01))
+                shade_sample(rast, pt, v0, v1, v2, w0, w1, w2);
+
+            w0 += e12.step_x;
+            w1 += e20.step_x;
+            w2 += e01.step_x;
+        }
+
+        w0_row += e12.step_y;
+        w1_row += e20.step_y;
+        w2_row += e01.step_y;
+    }
+}
 
-            if ( (w0 + f0 >= 0) && (w1 + f1 >= 0) && (w2 + f2 >= 0) ) {
+/*****************
+ * draw_tr_depth *
+ *****************/
 
-                /* normalize barycentric weights */
+/**
+ * rasterizes a screen space occluder conservatively into a 'width' 
+ * by 'height' buffer, the depth kept for a texel is never nearer 
+ * than the occluder anywhere in it, whatever its edges and slope
+ * 
+ * a texel the triangle covers whole lowers 'depths' to the farthest 
+ * depth of the triangle over it, one it only touches raises 'seams' 
+ * to that instead, and is marked in 'opens' if it reaches past one 
+ * of the edges set in 'open_edges', bit k for the edge across from 
+ * point k, that don't join the triangle to a neighbour beyond them, 
+ * so a texel no open edge crosses is covered by the triangles 
+ * touching it together and bounded by its seam depth
+ * 
+ * either winding is drawn since an occluder's back faces only lie 
+ * behind its front ones, and the box is clamped to the buffer as 
+ * the caller need not clip to the side planes
+ */
+
+void
+draw_tr_depth(float* depths, float* seams, uint8_t* opens, 
+              int width, int height, float* v0, float* v1, float* v2, 
+              int open_edges)
+{
+    float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - 
+                 (v2[0] - v0[0]) * (v1[1] - v0[1]);
+    if (area == 0)
+        return;
+
+    /* edge functions a x + b y + c, positive inside either winding */
+
+    float* v[3] = {v0, v1, v2};
+    float sign = area > 0 ? 1 : -1;
+    float a[3], b[3], c[3];
+
+    for (int k = 0; k < 3; k++) {
+        float* from = v[(k + 1) % 3];
+        float* to = v[(k + 2) % 3];
+        a[k] = sign * (from[1] - to[1]);
+        b[k] = sign * (to[0] - from[0]);
+        c[k] = -(a[k] * from[0] + b[k] * from[1]);
+    }
 
-                float area = w0 + w1 + w2;
-                
-                float b0 = w0 / area;
-                float b1 = w1 / area;
-                float b2 = w2 / area;
+    /* 1 / w as a plane over the screen, edge k weighs point k */
 
-                /* interpolate z and w */
+    float sum = sign * area;
+    float za = (a[0] * v0[3] + a[1] * v1[3] + a[2] * v2[3]) / sum;
+    float zb = (b[0] * v0[3] + b[1] * v1[3] + b[2] * v2[3]) / sum;
+    float zc = (c[0] * v0[3] + c[1] * v1[3] + c[2] * v2[3]) / sum;
 
-                float a = b0 * v0[3];
-                float b = b1 * v1[3];
-                float c = b2 * v2[3];
+    int x0 = fmaxf(floorf(fminf(v0[0], fminf(v1[0], v2[0]))), 0);
+    int y0 = fmaxf(floorf(fminf(v0[1], fminf(v1[1], v2[1]))), 0);
+    int x1 = fminf(ceilf(fmaxf(v0[0], fmaxf(v1[0], v2[0]))), width);
+    int y1 = fminf(ceilf(fmaxf(v0[1], fmaxf(v1[1], v2[1]))), height);
 
-                float Z = a + b + c;
+    /* texels reaching into all three half planes, or inside them */
 
-                pt[2] = 1 / Z;
-                pt[3] = Z;
+    for (int y = y0; y < y1; y++) {
+        size_t row = (size_t)y * width;
+        for (int x = x0; x < x1; x++) {
 
-                /* interpolate rest of points */
+            float cx = x + 0.5f;
+            float cy = y + 0.5f;
 
-                for (int i = 4; i < (int)rast->n_attr; i++) {
-                    float P = (a * v0[i] + b * v1[i] + c * v2[i]);
-                    pt[i] = P * pt[2]; /* to clip space */
-                }
+            /* an affine function's extremes lie half its slopes away */
 
-                draw_pt(rast, pt);
+            int touches = 1;
+            int covers = 1;
+            int crossed = 0;
+            for (int k = 0; k < 3; k++) {
+                float e = a[k] * cx + b[k] * cy + c[k];
+                float half = 0.5f * (fabsf(a[k]) + fabsf(b[k]));
+                touches &= e + half >= 0;
+                covers &= e - half >= 0;
+                crossed |= (open_edges >> k & 1) && e - half < 0;
             }
+            if (!touches)
+                continue;
+            if (crossed)
+                opens[row + x] = 1;
 
-            w0 += e12.step_x;
-            w1 += e20.step_x;
-            w2 += e01.step_x;
-        }
+            /* farthest where 1 / w is least */
 
-        w0_row += e12.step_y;
-        w1_row += e20.step_y;
-        w2_row += e01.step_y;
+            float z = za * cx + zb * cy + zc - 
+                      0.5f * (fabsf(za) + fabsf(zb));
+            float depth = z > 0 ? 1 / z : INFINITY;
+
+            if (covers && depth < depths[row + x])
+                depths[row + x] = depth;
+            if (depth > seams[row + x])
+                seams[row + x] = depth;
+        }
     }
 }
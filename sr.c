@@ -1,5 +1,6 @@
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "sr.h"
 #include "mat.h"
@@ -16,6 +17,64 @@
  * 
  */
 
+/*********************************************************************
+ *                                                                   *
+ *                       command list storage                        *
+ *                                                                   *
+ *********************************************************************/
+
+/*************
+ * cmd_state *
+ *************/
+
+/* lights, material and texture baked at record time, shared by draws */
+
+struct cmd_state {
+    struct light lights[SR_MAX_LIGHT_COUNT];
+    struct material material;
+    struct sr_texture texture;
+    int has_texture;
+    uint8_t light_state;
+    float ka;
+    float kd;
+    float ks;
+};
+
+/************
+ * cmd_draw *
+ ************/
+
+/* one recorded draw with everything derived from the matrices resolved */
+
+struct cmd_draw {
+    struct mat4 model;
+    struct mat4 normal_transform;
+    struct mat4 mvp;
+    float cam_pos[3];
+    int state;                      /* index into the list's states */
+    struct sr_framebuffer fbuf;
+    struct sr_pipeline pipe;
+    int base_uniform;               /* pipe read the context's uniform */
+    float bounds[6];                /* tested for occlusion on submit */
+    int has_bounds;
+    int* indices;                   /* not copied, must outlive the list */
+    int n_indices;
+    enum sr_primitive prim_type;
+};
+
+/***************
+ * sr_cmd_list *
+ ***************/
+
+struct sr_cmd_list {
+    struct cmd_draw* draws;
+    int n_draws;
+    int draws_cap;
+    struct cmd_state* states;
+    int n_states;
+    int states_cap;
+};
+
 /*********************************************************************
  *                                                                   *
  *          global variables that control pipeline state             *
@@ -30,92 +89,272 @@ static const struct mat4 identity = {
     0, 0, 0, 1
 };
 
-/* model matrix */
-static struct mat4 model = {
-    1, 0, 0, 0,
-    0, 1, 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1
+/* derived data that has to be rebuilt before the next draw */
+#define DIRTY_MVP       (1 << 0)
+#define DIRTY_NORMAL    (1 << 1)
+#define DIRTY_CAM_POS   (1 << 2)
+#define DIRTY_ALL       (DIRTY_MVP | DIRTY_NORMAL | DIRTY_CAM_POS)
+
+/* pixels a level of detail may stray from the full mesh */
+#define LOD_PIXEL_ERROR 1.0f
+
+/* what each matrix mode's matrix feeds into */
+static const uint8_t mode_dirties[] = {
+    [SR_MODEL_MATRIX] = DIRTY_MVP | DIRTY_NORMAL,
+    [SR_VIEW_MATRIX] = DIRTY_MVP | DIRTY_CAM_POS,
+    [SR_PROJECTION_MATRIX] = DIRTY_MVP,
+    [SR_MVP_MATRIX] = DIRTY_MVP
 };
 
-/* normal transform matrix */
-static struct mat4 normal_transform = {
-    1, 0, 0, 0,
-    0, 1, 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1
+/***************
+ * stack_entry *
+ ***************/
+
+/**
+ * a pushed matrix along with whatever was derived from it, so 
+ * popping back up a hierarchy doesn't rebuild anything
+ */
+
+struct stack_entry {
+    struct mat4 mat;
+    struct mat4 mvp;
+    struct mat4 normal_transform;
+    float cam_pos[3];
+    uint32_t others;                /* changes to the other modes at push */
+    uint8_t dirty;
+    uint8_t kind;
 };
 
-/* camera view matrix */
-static struct mat4 view = {
-    1, 0, 0, 0,
-    0, 1, 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1
+/*************
+ * mat_stack *
+ *************/
+
+/* fixed capacity, lives in the context so pushing never allocates */
+
+struct mat_stack {
+    struct stack_entry entries[SR_MAX_STACK_DEPTH];
+    int depth;
 };
 
-/* projection matrix */
-static struct mat4 proj = {
-    1, 0, 0, 0,
-    0, 1, 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1
+/**************
+ * sr_context *
+ **************/
+
+/* all state of the fixed pipeline, one per independent renderer */
+
+struct sr_context {
+    struct mat4 model;              /* model matrix */
+    struct mat4 normal_transform;   /* normal transform matrix */
+    struct mat4 view;               /* camera view matrix */
+    struct mat4 proj;               /* projection matrix */
+    struct mat4 mvp;                /* model view projection matrix */
+    struct mat4 instance_model;     /* model of the instance being drawn */
+    struct mat4 view_proj;          /* shared by every instance of a draw */
+    float* instances;               /* row major models of instanced draw */
+    struct light lights[SR_MAX_LIGHT_COUNT];
+    struct material material;
+    struct mat4* cur_mat;  /* points to whichever matrix stack is being used */
+    enum sr_matrix_mode mode;       /* the mode cur_mat was chosen by */
+    uint8_t dirty;                  /* DIRTY_* bits */
+    uint8_t kinds[4];               /* enum mat_kind of each mode */
+    uint32_t changes[4];            /* times each mode's matrix changed */
+    struct mat_stack stacks[4];     /* one per mode */
+    struct sr_texture texture;
+    struct sr_framebuffer fbuf;
+    struct sr_uniform uniform;
+    struct sr_pipeline pipe;
+    float bounds[6];                /* model space box of the bound points */
+    int has_bounds;
+    struct sr_occlusion* occlusion; /* tested after the frustum, or null */
+    int n_current;                  /* threads drawing with this context */
 };
 
-/* model view projection matrix */
-static struct mat4 mvp = {
-    1, 0, 0, 0,
-    0, 1, 0, 0,
-    0, 0, 1, 0,
-    0, 0, 0, 1
+/* context used by threads that never made one current */
+static struct sr_context g_default_ctx = {
+    .model = {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1
+    },
+    .normal_transform = {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1
+    },
+    .view = {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1
+    },
+    .proj = {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1
+    },
+    .mvp = {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1
+    },
+    .cur_mat = &g_default_ctx.model,
+    .mode = SR_MODEL_MATRIX,
+    .dirty = DIRTY_ALL,
+    .kinds = {MAT_RIGID, MAT_RIGID, MAT_RIGID, MAT_RIGID},
+    .uniform = {
+        .model = &g_default_ctx.model,
+        .normal_transform = &g_default_ctx.normal_transform,
+        .mvp = &g_default_ctx.mvp,
+        .has_texture = 0,
+        .material = &g_default_ctx.material,
+        .texture = &g_default_ctx.texture,
+        .lights = g_default_ctx.lights,
+        .ka = 1,
+        .kd = 1,
+        .ks = 1
+    },
+    .pipe = {
+        .fbuf = &g_default_ctx.fbuf,
+        .uniform = (void*)(&g_default_ctx.uniform),
+        .vs = 0,
+        .fs = 0,
+        .pts_in = 0,
+        .n_pts = 0,
+        .n_attr_in = 0,
+        .streams = 0,
+        .n_streams = 0,
+        .n_attr_out = 0,
+        .winding = SR_WINDING_ORDER_CCW,
+        .stats = 0
+    }
 };
 
-static struct light g_lights[SR_MAX_LIGHT_COUNT];
+/* the calling thread's current context */
+static __thread struct sr_context* ctx = &g_default_ctx;
 
-static struct material g_material;
+/*********************************************************************
+ *                                                                   *
+ *                             contexts                              *
+ *                                                                   *
+ *********************************************************************/
 
-static struct mat4* cur_mat;  /* points to whichever matrix stack is being used */
+/****************
+ * context_link *
+ ****************/
 
-static struct sr_texture g_texture = {
-    .colors = 0,
-    .width = 0,
-    .height = 0
-};
+/* points the uniform and pipeline of 'c' at its own storage */
+static void
+context_link(struct sr_context* c)
+{
+    c->cur_mat = &c->model;
+    c->mode = SR_MODEL_MATRIX;
+
+    c->uniform.model = &c->model;
+    c->uniform.normal_transform = &c->normal_transform;
+    c->uniform.mvp = &c->mvp;
+    c->uniform.material = &c->material;
+    c->uniform.texture = &c->texture;
+    c->uniform.lights = c->lights;
+
+    c->pipe.fbuf = &c->fbuf;
+    c->pipe.uniform = &c->uniform;
+}
 
-/* framebuffer */
-static struct sr_framebuffer g_fbuf = {
-    .width = 0,
-    .height = 0,
-    .colors = 0,
-    .depths = 0
-};
+/*********************
+ * sr_context_create *
+ *********************/
 
-/* uniform */
-static struct sr_uniform g_uniform = {
-    .model = &model,
-    .normal_transform = &normal_transform,
-    .mvp = &mvp,
-    .has_texture = 0,
-    .material = &g_material,
-    .texture = &g_texture,
-    .lights = g_lights,
-    .ka = 1,
-    .kd = 1,
-    .ks = 1
-};
+/* makes a context with the defaults every thread starts on */
+extern struct sr_context*
+sr_context_create()
+{
+    struct sr_context* c = calloc(1, sizeof(struct sr_context));
+    if (!c)
+        return 0;
+
+    c->model = identity;
+    c->normal_transform = identity;
+    c->view = identity;
+    c->proj = identity;
+    c->mvp = identity;
+    c->dirty = DIRTY_ALL;
+    for (int i = 0; i < 4; i++)
+        c->kinds[i] = MAT_RIGID;
+
+    c->uniform.ka = 1;
+    c->uniform.kd = 1;
+    c->uniform.ks = 1;
+    c->pipe.winding = SR_WINDING_ORDER_CCW;
+
+    context_link(c);
+    return c;
+}
 
-/* pipeline state */
-static struct sr_pipeline g_pipe = {
-    .fbuf = &g_fbuf,
-    .uniform = (void*)(&g_uniform),
-    .vs = 0,
-    .fs = 0,
-    .pts_in = 0,
-    .n_pts = 0,
-    .n_attr_in = 0,
-    .n_attr_out = 0,
-    .winding = SR_WINDING_ORDER_CCW
-};
+/*******************
+ * sr_context_free *
+ *******************/
+
+/**
+ * frees a context, the calling thread falls back to the default if 
+ * it was current there, returns 0 and frees nothing while any other 
+ * thread still has it current, make null current on those first
+ */
+extern int
+sr_context_free(struct sr_context* c)
+{
+    if (c == &g_default_ctx)
+        return 0;
+    if (!c)
+        return 1;
+
+    if (ctx == c)
+        sr_context_make_current(0);
+    if (__atomic_load_n(&c->n_current, __ATOMIC_ACQUIRE) > 0)
+        return 0;
+
+    free(c);
+    return 1;
+}
+
+/***************************
+ * sr_context_make_current *
+ ***************************/
+
+/**
+ * directs the calling thread's calls to 'c', null restores the 
+ * default, a thread should do so before it exits so the context 
+ * it drew with can be freed
+ */
+extern void
+sr_context_make_current(struct sr_context* c)
+{
+    if (!c)
+        c = &g_default_ctx;
+    if (c == ctx)
+        return;
+
+    if (c != &g_default_ctx)
+        __atomic_add_fetch(&c->n_current, 1, __ATOMIC_ACQ_REL);
+    if (ctx != &g_default_ctx)
+        __atomic_sub_fetch(&ctx->n_current, 1, __ATOMIC_ACQ_REL);
+
+    ctx = c;
+}
+
+/**********************
+ * sr_context_current *
+ **********************/
+
+/* the context the calling thread is drawing with */
+extern struct sr_context*
+sr_context_current()
+{
+    return ctx;
+}
 
 /*********************************************************************
  *                                                                   *
@@ -123,36 +362,661 @@ static struct sr_pipeline g_pipe = {
  *                                                                   *
  *********************************************************************/
 
+/*****************
+ * normal_matrix *
+ *****************/
+
+/**
+ * inverse transpose of the upper 3x3 of a model matrix, into 'dest', 
+ * a rotation is its own inverse transpose so rigid models skip the 
+ * work, and the upper 3x3 of anything else is affine
+ */
+static void
+normal_matrix(struct mat4* dest, struct mat4* src, enum mat_kind kind)
+{
+    *dest = *src;
+    upper_3x3(dest);
+    if (kind == MAT_RIGID)
+        return;
+    transpose(dest);
+    invert_affine(dest);
+}
+
+/*******************
+ * camera_position *
+ *******************/
+
+/**
+ * world space eye position, the image of the origin under the 
+ * inverse view matrix, which is that inverse's last column
+ */
+static void
+camera_position(float* dest)
+{
+    struct mat4 view_inverse = ctx->view;
+    invert_as(&view_inverse, ctx->kinds[SR_VIEW_MATRIX]);
+
+    dest[0] = view_inverse.e03;
+    dest[1] = view_inverse.e13;
+    dest[2] = view_inverse.e23;
+}
+
+/******************
+ * frustum_planes *
+ ******************/
+
+/**
+ * the five planes the pipeline clips against, pulled back through 
+ * 'm' from the rows of clip space, as unit normals and offsets 
+ * where points inside give a positive distance
+ */
+static void
+frustum_planes(float planes[5][4], struct mat4* m)
+{
+    float r0[4] = {m->e00, m->e01, m->e02, m->e03};
+    float r1[4] = {m->e10, m->e11, m->e12, m->e13};
+    float r2[4] = {m->e20, m->e21, m->e22, m->e23};
+    float r3[4] = {m->e30, m->e31, m->e32, m->e33};
+
+    for (int k = 0; k < 4; k++) {
+        planes[0][k] = r3[k] + r0[k];     /* left */
+        planes[1][k] = r3[k] + r1[k];     /* bottom */
+        planes[2][k] = r3[k] + r2[k];     /* near */
+        planes[3][k] = r3[k] - r0[k];     /* right */
+        planes[4][k] = r3[k] - r1[k];     /* top */
+    }
+
+    for (int i = 0; i < 5; i++) {
+        float len = magnitude(planes[i]);
+        if (len == 0)
+            continue;
+        for (int k = 0; k < 4; k++)
+            planes[i][k] /= len;
+    }
+}
+
+/*************
+ * model_eye *
+ *************/
+
+/* the eye position in the current model's space */
+static void
+model_eye(float* dest)
+{
+    struct mat4 model_view = ctx->view;
+    matmul(&model_view, &ctx->model);
+
+    enum mat_kind kind = ctx->kinds[SR_VIEW_MATRIX];
+    if (ctx->kinds[SR_MODEL_MATRIX] < kind)
+        kind = ctx->kinds[SR_MODEL_MATRIX];
+    invert_as(&model_view, kind);
+
+    dest[0] = model_view.e03;
+    dest[1] = model_view.e13;
+    dest[2] = model_view.e23;
+}
+
+/******************
+ * meshlet_culled *
+ ******************/
+
+/**
+ * true if a meshlet's sphere lies wholly outside one plane, or if 
+ * the eye sees every triangle in it from behind, 'winding' flips 
+ * the cone for clockwise meshes
+ */
+static int
+meshlet_culled(struct sr_meshlet* m, float planes[5][4], 
+               float* eye, int winding)
+{
+    for (int i = 0; i < 5; i++) {
+        if (dot(planes[i], m->center) + planes[i][3] < -m->radius)
+            return 1;
+    }
+
+    float d[3] = {
+        m->center[0] - eye[0], 
+        m->center[1] - eye[1], 
+        m->center[2] - eye[2]
+    };
+
+    return dot(d, m->cone_axis) * winding > 
+           m->cone_cutoff * magnitude(d) + m->radius;
+}
+
+/******************
+ * frustum_culled *
+ ******************/
+
+/**
+ * true if the box bound with the points lies wholly outside one 
+ * clip plane, found by clip testing its eight corners, counts the 
+ * draw as culled
+ */
+static int
+frustum_culled()
+{
+    if (!ctx->has_bounds)
+        return 0;
+
+    float corners[8 * 4];
+    for (int i = 0; i < 8; i++) {
+        corners[4 * i] = ctx->bounds[i & 1 ? 3 : 0];
+        corners[4 * i + 1] = ctx->bounds[i & 2 ? 4 : 1];
+        corners[4 * i + 2] = ctx->bounds[i & 4 ? 5 : 2];
+        corners[4 * i + 3] = 1;
+    }
+
+    float clip[8 * 4];
+    vec4_matmul_n(clip, &ctx->mvp, corners, 8, 4);
+
+    uint8_t flags[8];
+    clip_test_batch(clip, 8, 4, flags);
+
+    uint8_t outside = 0xff;
+    for (int i = 0; i < 8; i++)
+        outside &= flags[i];
+
+    if (outside) {
+        if (ctx->pipe.stats)
+            ctx->pipe.stats->n_draw_culled++;
+        return 1;
+    }
+    return 0;
+}
+
+/********************
+ * occlusion_culled *
+ ********************/
+
+/**
+ * true if the box 'bounds' seen through 'mvp' lies behind the bound 
+ * occluders, counts the draw as culled in 'stats' if not null
+ */
+static int
+occlusion_culled(struct mat4* mvp, float* bounds, struct sr_stats* stats)
+{
+    if (!ctx->occlusion || !occlusion_test(ctx->occlusion, mvp, bounds))
+        return 0;
+
+    if (stats)
+        stats->n_occlusion_culled++;
+    return 1;
+}
+
+/*****************
+ * bounds_culled *
+ *****************/
+
+/* true if the bound box is outside the frustum or behind the occluders */
+static int
+bounds_culled()
+{
+    return frustum_culled() || 
+           (ctx->has_bounds && 
+            occlusion_culled(&ctx->mvp, ctx->bounds, ctx->pipe.stats));
+}
+
+/******************
+ * update_derived *
+ ******************/
+
+/* rebuilds whatever the matrix operations since the last draw invalidated */
+static void
+update_derived()
+{
+    if (ctx->dirty & DIRTY_MVP) {
+        ctx->mvp = ctx->proj;
+        matmul(&ctx->mvp, &ctx->view);
+        matmul(&ctx->mvp, &ctx->model);
+    }
+
+    if (ctx->dirty & DIRTY_NORMAL)
+        normal_matrix(&ctx->normal_transform, &ctx->model, 
+                      ctx->kinds[SR_MODEL_MATRIX]);
+
+    if (ctx->dirty & DIRTY_CAM_POS)
+        camera_position(ctx->uniform.cam_pos);
+
+    ctx->dirty = 0;
+}
+
+/********************
+ * instance_uniform *
+ ********************/
+
+/**
+ * fills the model, mvp and normal matrices 'uniform', an sr_uniform, 
+ * points at for one instance, whose model matrix is the current model 
+ * matrix followed by the instance's own
+ */
+static void
+instance_uniform(void* uniform, int instance_id)
+{
+    struct sr_uniform* u = uniform;
+    float* src = ctx->instances + 16 * instance_id;
+    struct mat4 m = {
+        src[0], src[1], src[2], src[3],
+        src[4], src[5], src[6], src[7],
+        src[8], src[9], src[10], src[11],
+        src[12], src[13], src[14], src[15]
+    };
+
+    *u->model = ctx->model;
+    matmul(u->model, &m);
+
+    *u->mvp = ctx->view_proj;
+    matmul(u->mvp, u->model);
+
+    normal_matrix(u->normal_transform, u->model, MAT_GENERAL);
+}
+
 /**************
  * sr_renderl *
  **************/
 
-/* builds the mvp and renders the global state */
+/* brings the mvp up to date and renders the global state */
 extern void
 sr_renderl(int* indices, int n_indices, enum sr_primitive prim_type)
 {
-    /* create mvp */
-    mvp = identity;
-    matmul(&mvp, &proj);
-    matmul(&mvp, &view);
-    matmul(&mvp, &model);
-
-    /* create normal transform matrix */
-    normal_transform = model;
-    upper_3x3(&normal_transform);
-    transpose(&normal_transform);
-    invert(&normal_transform);
-
-    /* camera position */
-    float origin[4] = {0, 0, 0, 1};
-    float tmp[4];
-    struct mat4 view_inverse = view;
-    invert(&view_inverse);
-    vec4_matmul(tmp, &view_inverse, origin);
-    memcpy(g_uniform.cam_pos, tmp, 3 * sizeof(float));
+    /* mvp, normal transform and camera position */
+    update_derived();
+
+    if (bounds_culled())
+        return;
 
     /* send down the pipeline */
-    sr_render(&g_pipe, indices, n_indices, prim_type);
+    sr_render(&ctx->pipe, indices, n_indices, prim_type);
+}
+
+/*****************
+ * sr_multi_draw *
+ *****************/
+
+/**
+ * renders a batch of draw records against the global state,
+ * building the matrices once for all of them
+ * 
+ * the bound box culls the batch as a whole, so it must enclose the 
+ * points of every draw in it, not just one draw's range
+ */
+extern void
+sr_multi_draw(int* indices, struct sr_draw* draws, 
+              int n_draws, enum sr_primitive prim_type)
+{
+    update_derived();
+
+    if (bounds_culled())
+        return;
+
+    sr_render_multi(&ctx->pipe, indices, draws, n_draws, prim_type);
+}
+
+/*****************
+ * sr_select_lod *
+ *****************/
+
+/**
+ * picks the coarsest of 'n_lods' levels of detail whose error, seen 
+ * from the eye at the nearest point of the bound box, covers at 
+ * most LOD_PIXEL_ERROR pixels of the framebuffer, assumes a 
+ * perspective projection, the first level if no bounds are bound
+ */
+extern int
+sr_select_lod(struct sr_lod* lods, int n_lods)
+{
+    if (!ctx->has_bounds)
+        return 0;
+
+    float eye[3];
+    model_eye(eye);
+
+    /* squared distance from the eye to the box, 0 inside it */
+
+    float dist2 = 0;
+    for (int k = 0; k < 3; k++) {
+        float out = ctx->bounds[k] - eye[k];
+        if (eye[k] - ctx->bounds[k + 3] > out)
+            out = eye[k] - ctx->bounds[k + 3];
+        if (out > 0)
+            dist2 += out * out;
+    }
+
+    /* pixels per model unit one unit in front of the eye */
+
+    float scale = ctx->proj.e11 * ctx->fbuf.height / 2;
+
+    for (int i = n_lods - 1; i > 0; i--) {
+        float px = lods[i].error * scale;
+        if (px * px <= LOD_PIXEL_ERROR * LOD_PIXEL_ERROR * dist2)
+            return i;
+    }
+
+    return 0;
+}
+
+/****************
+ * sr_draw_lods *
+ ****************/
+
+/**
+ * renders the level of detail sr_select_lod picks of a triangle 
+ * list whose points and bounds are bound, after the bounds checks 
+ * every draw gets
+ */
+extern void
+sr_draw_lods(int* indices, struct sr_lod* lods, int n_lods)
+{
+    update_derived();
+
+    if (bounds_culled())
+        return;
+
+    struct sr_lod* lod = lods + sr_select_lod(lods, n_lods);
+    sr_render(&ctx->pipe, indices + lod->first_index, lod->n_indices, 
+              SR_TRIANGLE_LIST);
+}
+
+/********************
+ * sr_draw_meshlets *
+ ********************/
+
+/**
+ * renders the meshlets of a meshlet mesh whose points are bound, 
+ * skipping those outside the frustum or facing away before any of 
+ * their points are shaded
+ */
+extern void
+sr_draw_meshlets(int* indices, struct sr_meshlet* meshlets, 
+                 int n_meshlets)
+{
+    update_derived();
+
+    float planes[5][4];
+    frustum_planes(planes, &ctx->mvp);
+
+    float eye[3];
+    model_eye(eye);
+
+    struct sr_draw* draws = malloc(n_meshlets * sizeof(struct sr_draw));
+    if (!draws)
+        return;
+
+    int n_draws = 0;
+    for (int i = 0; i < n_meshlets; i++) {
+        struct sr_meshlet* m = meshlets + i;
+        if (meshlet_culled(m, planes, eye, ctx->pipe.winding))
+            continue;
+        draws[n_draws++] = (struct sr_draw){
+            .first_index = m->first_index,
+            .n_indices = m->n_indices,
+            .base_vertex = m->base_vertex
+        };
+    }
+
+    if (ctx->pipe.stats)
+        ctx->pipe.stats->n_meshlet_culled += n_meshlets - n_draws;
+
+    sr_render_multi(&ctx->pipe, indices, draws, n_draws, SR_TRIANGLE_LIST);
+
+    free(draws);
+}
+
+/***************
+ * sr_occluder *
+ ***************/
+
+/**
+ * draws an occluder, whose positions are the first three of its 
+ * 'n_attr' attributes, depth only into 'occ' with the current 
+ * matrices, keep occluders few, large and inside what they hide
+ */
+extern void
+sr_occluder(struct sr_occlusion* occ, float* pts, int n_pts, 
+            int n_attr, int* indices, int n_indices)
+{
+    update_derived();
+
+    occlusion_draw(occ, &ctx->mvp, pts, n_pts, n_attr, 
+                   indices, n_indices);
+}
+
+/************************
+ * sr_renderl_instanced *
+ ************************/
+
+/**
+ * renders the global state once per model matrix in 'models', 
+ * given as 'n_instances' row major 4x4s back to back
+ * 
+ * everything that doesn't depend on the instance, the view 
+ * projection product and the camera position, is built once, a 
+ * custom uniform bound in place of the fixed one must be an 
+ * sr_uniform too, whose matrices are overwritten
+ */
+extern void
+sr_renderl_instanced(int* indices, int n_indices, 
+                     enum sr_primitive prim_type, 
+                     float* models, int n_instances)
+{
+    update_derived();
+
+    ctx->view_proj = ctx->proj;
+    matmul(&ctx->view_proj, &ctx->view);
+
+    ctx->instances = models;
+    ctx->uniform.model = &ctx->instance_model;
+
+    sr_render_instanced(&ctx->pipe, indices, n_indices, prim_type, 
+                        n_instances, instance_uniform);
+
+    ctx->uniform.model = &ctx->model;
+    ctx->instances = 0;
+
+    /* the instances overwrote these */
+    ctx->dirty |= DIRTY_MVP | DIRTY_NORMAL;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                          command lists                            *
+ *                                                                   *
+ *********************************************************************/
+
+/**********************
+ * sr_cmd_list_create *
+ **********************/
+
+/* makes an empty command list */
+extern struct sr_cmd_list*
+sr_cmd_list_create()
+{
+    return calloc(1, sizeof(struct sr_cmd_list));
+}
+
+/********************
+ * sr_cmd_list_free *
+ ********************/
+
+/* frees a command list and everything it recorded */
+extern void
+sr_cmd_list_free(struct sr_cmd_list* list)
+{
+    free(list->draws);
+    free(list->states);
+    free(list);
+}
+
+/*********************
+ * sr_cmd_list_reset *
+ *********************/
+
+/* forgets recorded draws but keeps the memory for the next recording */
+extern void
+sr_cmd_list_reset(struct sr_cmd_list* list)
+{
+    list->n_draws = 0;
+    list->n_states = 0;
+}
+
+/**************
+ * bake_state *
+ **************/
+
+/**
+ * snapshots lights, material and texture into the list, reusing 
+ * the previous snapshot if nothing changed since, returns its index
+ */
+static int
+bake_state(struct sr_cmd_list* list)
+{
+    struct cmd_state state;
+    memset(&state, 0, sizeof(state));    /* so padding compares equal */
+
+    memcpy(state.lights, ctx->lights, sizeof(ctx->lights));
+    state.material = ctx->material;
+    state.texture = ctx->texture;
+    state.has_texture = ctx->uniform.has_texture;
+    state.light_state = ctx->uniform.light_state;
+    state.ka = ctx->uniform.ka;
+    state.kd = ctx->uniform.kd;
+    state.ks = ctx->uniform.ks;
+
+    if (list->n_states > 0 && 
+        memcmp(&state, list->states + list->n_states - 1, 
+               sizeof(state)) == 0)
+        return list->n_states - 1;
+
+    if (list->n_states == list->states_cap) {
+        int cap = list->states_cap ? 2 * list->states_cap : 4;
+        struct cmd_state* states = realloc(list->states, 
+                                           cap * sizeof(*states));
+        if (!states)
+            return -1;
+        list->states = states;
+        list->states_cap = cap;
+    }
+
+    list->states[list->n_states] = state;
+    return list->n_states++;
+}
+
+/***************
+ * sr_cmd_draw *
+ ***************/
+
+/**
+ * records a draw of the currently bound state into 'list', 
+ * resolving the mvp, normal matrix and camera position now so 
+ * replay does no matrix work, returns 0 if the state can't be drawn
+ * 
+ * a draw whose bounds are outside the frustum is dropped here, 
+ * and counted once, rather than recorded, while occlusion depends 
+ * on the occluders drawn for each frame so is tested on submit
+ */
+extern int
+sr_cmd_draw(struct sr_cmd_list* list, int* indices, 
+            int n_indices, enum sr_primitive prim_type)
+{
+    /* validate */
+
+    if (!ctx->pipe.vs || !ctx->pipe.fs || 
+        !(ctx->pipe.pts_in || ctx->pipe.n_streams) || !ctx->fbuf.colors)
+        return 0;
+    if (ctx->pipe.n_attr_out > SR_MAX_ATTRIBUTE_COUNT)
+        return 0;
+
+    update_derived();
+    if (frustum_culled())
+        return 1;
+
+    if (list->n_draws == list->draws_cap) {
+        int cap = list->draws_cap ? 2 * list->draws_cap : 16;
+        struct cmd_draw* draws = realloc(list->draws, 
+                                         cap * sizeof(*draws));
+        if (!draws)
+            return 0;
+        list->draws = draws;
+        list->draws_cap = cap;
+    }
+
+    int state = bake_state(list);
+    if (state < 0)
+        return 0;
+
+    /* resolve */
+
+    struct cmd_draw* draw = list->draws + list->n_draws;
+
+    draw->model = ctx->model;
+    draw->mvp = ctx->mvp;
+    draw->normal_transform = ctx->normal_transform;
+    memcpy(draw->cam_pos, ctx->uniform.cam_pos, 3 * sizeof(float));
+
+    draw->state = state;
+    draw->fbuf = ctx->fbuf;
+    draw->pipe = ctx->pipe;
+    draw->base_uniform = ctx->pipe.uniform == &ctx->uniform;
+    memcpy(draw->bounds, ctx->bounds, sizeof(draw->bounds));
+    draw->has_bounds = ctx->has_bounds;
+    draw->indices = indices;
+    draw->n_indices = n_indices;
+    draw->prim_type = prim_type;
+
+    list->n_draws++;
+    return 1;
+}
+
+/*************
+ * sr_submit *
+ *************/
+
+/**
+ * replays command lists in the order given, pointing the current 
+ * context's fixed uniform at each draw's resolved data, then 
+ * restores the state that was bound before, draws with bounds are 
+ * skipped if behind the occluders the current context has bound
+ */
+extern void
+sr_submit(struct sr_cmd_list** lists, int n_lists)
+{
+    struct sr_uniform saved = ctx->uniform;
+
+    for (int i = 0; i < n_lists; i++) {
+        for (int j = 0; j < lists[i]->n_draws; j++) {
+
+            struct cmd_draw* draw = lists[i]->draws + j;
+            struct cmd_state* state = lists[i]->states + draw->state;
+
+            if (draw->has_bounds && 
+                occlusion_culled(&draw->mvp, draw->bounds, draw->pipe.stats))
+                continue;
+
+            ctx->uniform.model = &draw->model;
+            ctx->uniform.normal_transform = &draw->normal_transform;
+            ctx->uniform.mvp = &draw->mvp;
+            memcpy(ctx->uniform.cam_pos, draw->cam_pos, 3 * sizeof(float));
+
+            ctx->uniform.lights = state->lights;
+            ctx->uniform.material = &state->material;
+            ctx->uniform.texture = &state->texture;
+            ctx->uniform.has_texture = state->has_texture;
+            ctx->uniform.light_state = state->light_state;
+            ctx->uniform.ka = state->ka;
+            ctx->uniform.kd = state->kd;
+            ctx->uniform.ks = state->ks;
+
+            struct sr_pipeline pipe = draw->pipe;
+            pipe.fbuf = &draw->fbuf;
+            if (draw->base_uniform)
+                pipe.uniform = &ctx->uniform;
+
+            sr_render(&pipe, draw->indices, draw->n_indices, 
+                      draw->prim_type);
+        }
+    }
+
+    ctx->uniform = saved;
 }
 
 /*********************************************************************
@@ -169,9 +1033,69 @@ sr_renderl(int* indices, int n_indices, enum sr_primitive prim_type)
 extern void
 sr_bind_pts(float* pts, int n_pts, int n_attr)
 {
-    g_pipe.pts_in = pts;
-    g_pipe.n_pts = n_pts;
-    g_pipe.n_attr_in = n_attr;
+    ctx->pipe.pts_in = pts;
+    ctx->pipe.n_pts = n_pts;
+    ctx->pipe.n_attr_in = n_attr;
+    ctx->pipe.streams = 0;
+    ctx->pipe.n_streams = 0;
+    ctx->has_bounds = 0;
+}
+
+/*******************
+ * sr_bind_streams *
+ *******************/
+
+/**
+ * sets points as separate attribute streams instead of one 
+ * interleaved array, the streams array itself must stay alive, 
+ * binding only the position stream makes position-only passes 
+ * read nothing else
+ */
+extern void
+sr_bind_streams(struct sr_stream* streams, int n_streams, int n_pts)
+{
+    int n_attr = 0;
+    for (int i = 0; i < n_streams; i++)
+        n_attr += streams[i].n_attr;
+
+    ctx->pipe.pts_in = 0;
+    ctx->pipe.n_pts = n_pts;
+    ctx->pipe.n_attr_in = n_attr;
+    ctx->pipe.streams = streams;
+    ctx->pipe.n_streams = n_streams;
+    ctx->has_bounds = 0;
+}
+
+/******************
+ * sr_bind_bounds *
+ ******************/
+
+/**
+ * sets the model space box, min x, y, z then max x, y, z, holding 
+ * the bound points, draws of them that fall wholly outside the 
+ * frustum are skipped before any vertex work, binding points 
+ * clears it so bind this after them, null to never skip
+ */
+extern void
+sr_bind_bounds(float* bounds)
+{
+    ctx->has_bounds = bounds != 0;
+    if (bounds)
+        memcpy(ctx->bounds, bounds, sizeof(ctx->bounds));
+}
+
+/*********************
+ * sr_bind_occlusion *
+ *********************/
+
+/**
+ * tests the bounds of later draws against the occluders in 'occ', 
+ * null to stop, only draws with bounds bound can be culled
+ */
+extern void
+sr_bind_occlusion(struct sr_occlusion* occ)
+{
+    ctx->occlusion = occ;
 }
 
 /***********************
@@ -182,10 +1106,56 @@ sr_bind_pts(float* pts, int n_pts, int n_attr)
 extern void
 sr_bind_framebuffer(int width, int height, uint32_t* colors, float* depths)
 {
-    g_fbuf.width = width;
-    g_fbuf.height = height;
-    g_fbuf.colors = colors;
-    g_fbuf.depths = depths;
+    ctx->fbuf.width = width;
+    ctx->fbuf.height = height;
+    ctx->fbuf.colors = colors;
+    ctx->fbuf.depths = depths;
+}
+
+/*******************
+ * sr_bind_samples *
+ *******************/
+
+/**
+ * multisamples later draws into 'colors' and 'depths', each holding 
+ * 'n_samples' entries per pixel of the bound framebuffer, pixel by 
+ * pixel, 'n_samples' is 2, 4 or 8, or 1 to draw straight to the 
+ * framebuffer again, clear these in place of the framebuffer's own, 
+ * returns 0 and leaves the binding as it was for any other count
+ */
+extern int
+sr_bind_samples(int n_samples, uint32_t* colors, float* depths)
+{
+    if (n_samples < 1 || n_samples > SR_MAX_SAMPLES || 
+        n_samples & (n_samples - 1))
+        return 0;
+
+    ctx->fbuf.n_samples = n_samples;
+    ctx->fbuf.sample_colors = colors;
+    ctx->fbuf.sample_depths = depths;
+    return 1;
+}
+
+/***************
+ * sr_resolvel *
+ ***************/
+
+/* averages the bound samples into the framebuffer, once per frame */
+extern void
+sr_resolvel()
+{
+    sr_resolve(&ctx->fbuf);
+}
+
+/************
+ * sr_fxaal *
+ ************/
+
+/* anti-aliases the bound framebuffer's colors, after the last draw */
+extern int
+sr_fxaal()
+{
+    return sr_fxaa(&ctx->fbuf);
 }
 
 /*******************
@@ -196,7 +1166,7 @@ sr_bind_framebuffer(int width, int height, uint32_t* colors, float* depths)
 extern void
 sr_bind_uniform(void* uniform)
 {
-    g_pipe.uniform = uniform;
+    ctx->pipe.uniform = uniform;
 }
 
 /**********************
@@ -207,7 +1177,7 @@ sr_bind_uniform(void* uniform)
 extern void
 sr_restore_uniform()
 {
-    g_pipe.uniform = &g_uniform;
+    ctx->pipe.uniform = &ctx->uniform;
 }
 
 /**************
@@ -218,8 +1188,8 @@ sr_restore_uniform()
 extern void
 sr_bind_vs(vs_f vs, int n_attr_out)
 {
-    g_pipe.vs = vs;
-    g_pipe.n_attr_out = n_attr_out;
+    ctx->pipe.vs = vs;
+    ctx->pipe.n_attr_out = n_attr_out;
 }
 
 /**************
@@ -230,7 +1200,18 @@ sr_bind_vs(vs_f vs, int n_attr_out)
 extern void
 sr_bind_fs(fs_f fs)
 {
-    g_pipe.fs = fs;
+    ctx->pipe.fs = fs;
+}
+
+/*****************
+ * sr_bind_stats *
+ *****************/
+
+/* counts culled primitives into 'stats', null to stop counting */
+extern void
+sr_bind_stats(struct sr_stats* stats)
+{
+    ctx->pipe.stats = stats;
 }
 
 /*******************
@@ -241,10 +1222,10 @@ sr_bind_fs(fs_f fs)
 extern void
 sr_bind_texture(uint32_t* colors, int width, int height)
 {
-    g_uniform.has_texture = 1;
-    g_texture.colors = colors;
-    g_texture.width = width;
-    g_texture.height = height;
+    ctx->uniform.has_texture = 1;
+    ctx->texture.colors = colors;
+    ctx->texture.width = width;
+    ctx->texture.height = height;
 }
 
 /*********************************************************************
@@ -265,28 +1246,28 @@ sr_light(enum sr_light slot, enum sr_light_attr attr, float* data)
     /* split attribute data */
     switch(attr) {
         case SR_POSITION:
-            memcpy(g_lights[slot].pos, data, 3 * sizeof(float));
+            memcpy(ctx->lights[slot].pos, data, 3 * sizeof(float));
             break;
         case SR_DIRECTION:
-            memcpy(g_lights[slot].dir, data, 3 * sizeof(float));
+            memcpy(ctx->lights[slot].dir, data, 3 * sizeof(float));
             break;
         case SR_COLOR:
-            memcpy(g_lights[slot].color, data, 4 * sizeof(float));
+            memcpy(ctx->lights[slot].color, data, 4 * sizeof(float));
             break;
         case SR_SPOT_ANGLE:
-            g_lights[slot].spot_angle = *data;
+            ctx->lights[slot].spot_angle = *data;
             break;
         case SR_SPOT_PENUMBRA:
-            g_lights[slot].spot_penumbra = *data;
+            ctx->lights[slot].spot_penumbra = *data;
             break;
         case SR_CONSTANT_ATTENUATION:
-            g_lights[slot].attn_const = *data;
+            ctx->lights[slot].attn_const = *data;
             break;
         case SR_LINEAR_ATTENUATION:
-            g_lights[slot].attn_lin = *data;
+            ctx->lights[slot].attn_lin = *data;
             break;
         case SR_QUADRATIC_ATTENUATION:
-            g_lights[slot].attn_quad = *data;
+            ctx->lights[slot].attn_quad = *data;
             break;
         default:
             return;
@@ -304,13 +1285,13 @@ sr_glight(enum sr_light_attr attr, float* data)
     /* split attribute data */
     switch(attr) {
         case SR_AMBIENT:
-            g_uniform.ka = *data;
+            ctx->uniform.ka = *data;
             break;
         case SR_DIFFUSE:
-            g_uniform.kd = *data;
+            ctx->uniform.kd = *data;
             break;
         case SR_SPECULAR:
-            g_uniform.ks = *data;
+            ctx->uniform.ks = *data;
             break;
         default:
             return;
@@ -329,13 +1310,13 @@ sr_light_type(enum sr_light slot, enum sr_light_type type)
     int idx = split_light(slot);
     switch (type) {
         case SR_DIRECTIONAL:
-            g_lights[idx].type = 1 << 0;
+            ctx->lights[idx].type = 1 << 0;
             break;
         case SR_POINT:
-            g_lights[idx].type = 1 << 1;
+            ctx->lights[idx].type = 1 << 1;
             break;
         case SR_SPOT:
-            g_lights[idx].type = 1 << 2;
+            ctx->lights[idx].type = 1 << 2;
             break;
     }
 }
@@ -349,7 +1330,7 @@ sr_light_type(enum sr_light slot, enum sr_light_type type)
 extern void 
 sr_light_enable(enum sr_light slot)
 {
-    g_uniform.light_state |= 1 << slot;
+    ctx->uniform.light_state |= 1 << slot;
 }
 
 /********************
@@ -360,7 +1341,7 @@ sr_light_enable(enum sr_light slot)
 extern void 
 sr_light_disable(enum sr_light slot)
 {
-    g_uniform.light_state &= ~(1 << slot);
+    ctx->uniform.light_state &= ~(1 << slot);
 }
 
 /***************
@@ -373,19 +1354,19 @@ sr_material(enum sr_light_attr attr, float* data)
 {
     switch(attr) {
         case SR_AMBIENT:
-            memcpy(g_material.ambient, data, 4 * sizeof(float));
+            memcpy(ctx->material.ambient, data, 4 * sizeof(float));
             break;
        case SR_DIFFUSE:
-            memcpy(g_material.diffuse, data, 4 * sizeof(float));
+            memcpy(ctx->material.diffuse, data, 4 * sizeof(float));
             break;
         case SR_SPECULAR:
-            memcpy(g_material.specular, data, 4 * sizeof(float));
+            memcpy(ctx->material.specular, data, 4 * sizeof(float));
             break;
         case SR_BLEND:
-            g_material.blend = *data;
+            ctx->material.blend = *data;
             break;
         case SR_SHININESS:
-            g_material.shininess = *data;
+            ctx->material.shininess = *data;
             break;
         default:
             return;
@@ -398,6 +1379,24 @@ sr_material(enum sr_light_attr attr, float* data)
  *                                                                   *
  *********************************************************************/
 
+/*********
+ * touch *
+ *********/
+
+/**
+ * marks what depends on the current matrix as stale after 'kind' 
+ * was multiplied onto it, the product is only as special as the 
+ * least special factor
+ */
+static void
+touch(enum mat_kind kind)
+{
+    ctx->changes[ctx->mode]++;
+    ctx->dirty |= mode_dirties[ctx->mode];
+    if (kind < ctx->kinds[ctx->mode])
+        ctx->kinds[ctx->mode] = kind;
+}
+
 /******************
  * sr_matrix_mode *
  ******************/
@@ -406,18 +1405,20 @@ sr_material(enum sr_light_attr attr, float* data)
 extern void
 sr_matrix_mode(enum sr_matrix_mode mode)
 {
+    ctx->mode = mode;
+
     switch (mode) {
         case SR_MODEL_MATRIX:
-            cur_mat = &model;
+            ctx->cur_mat = &ctx->model;
             break;
         case SR_VIEW_MATRIX:
-            cur_mat = &view;
+            ctx->cur_mat = &ctx->view;
             break;
         case SR_PROJECTION_MATRIX:
-            cur_mat = &proj;
+            ctx->cur_mat = &ctx->proj;
             break;
         case SR_MVP_MATRIX:
-            cur_mat = &mvp;
+            ctx->cur_mat = &ctx->mvp;
             break;
     }
 }
@@ -430,22 +1431,22 @@ sr_matrix_mode(enum sr_matrix_mode mode)
 extern void
 sr_dump_matrix(float* dest)
 {
-    dest[0] = cur_mat->e00;
-    dest[1] = cur_mat->e01;
-    dest[2] = cur_mat->e02;
-    dest[3] = cur_mat->e03;
-    dest[4] = cur_mat->e10;
-    dest[5] = cur_mat->e11;
-    dest[6] = cur_mat->e12;
-    dest[7] = cur_mat->e13;
-    dest[8] = cur_mat->e20;
-    dest[9] = cur_mat->e21;
-    dest[10] = cur_mat->e22;
-    dest[11] = cur_mat->e23;
-    dest[12] = cur_mat->e30;
-    dest[13] = cur_mat->e31;
-    dest[14] = cur_mat->e32;
-    dest[15] = cur_mat->e33;
+    dest[0] = ctx->cur_mat->e00;
+    dest[1] = ctx->cur_mat->e01;
+    dest[2] = ctx->cur_mat->e02;
+    dest[3] = ctx->cur_mat->e03;
+    dest[4] = ctx->cur_mat->e10;
+    dest[5] = ctx->cur_mat->e11;
+    dest[6] = ctx->cur_mat->e12;
+    dest[7] = ctx->cur_mat->e13;
+    dest[8] = ctx->cur_mat->e20;
+    dest[9] = ctx->cur_mat->e21;
+    dest[10] = ctx->cur_mat->e22;
+    dest[11] = ctx->cur_mat->e23;
+    dest[12] = ctx->cur_mat->e30;
+    dest[13] = ctx->cur_mat->e31;
+    dest[14] = ctx->cur_mat->e32;
+    dest[15] = ctx->cur_mat->e33;
 }
 
 /******************
@@ -456,22 +1457,25 @@ sr_dump_matrix(float* dest)
 extern void
 sr_load_matrix(float* src)
 {
-    cur_mat->e00 = src[0];
-    cur_mat->e01 = src[1];
-    cur_mat->e02 = src[2];
-    cur_mat->e03 = src[3];
-    cur_mat->e10 = src[4];
-    cur_mat->e11 = src[5];
-    cur_mat->e12 = src[6];
-    cur_mat->e13 = src[7];
-    cur_mat->e20 = src[8];
-    cur_mat->e21 = src[9];
-    cur_mat->e22 = src[10];
-    cur_mat->e23 = src[11];
-    cur_mat->e30 = src[12];
-    cur_mat->e31 = src[13];
-    cur_mat->e32 = src[14];
-    cur_mat->e33 = src[15];
+    ctx->cur_mat->e00 = src[0];
+    ctx->cur_mat->e01 = src[1];
+    ctx->cur_mat->e02 = src[2];
+    ctx->cur_mat->e03 = src[3];
+    ctx->cur_mat->e10 = src[4];
+    ctx->cur_mat->e11 = src[5];
+    ctx->cur_mat->e12 = src[6];
+    ctx->cur_mat->e13 = src[7];
+    ctx->cur_mat->e20 = src[8];
+    ctx->cur_mat->e21 = src[9];
+    ctx->cur_mat->e22 = src[10];
+    ctx->cur_mat->e23 = src[11];
+    ctx->cur_mat->e30 = src[12];
+    ctx->cur_mat->e31 = src[13];
+    ctx->cur_mat->e32 = src[14];
+    ctx->cur_mat->e33 = src[15];
+
+    touch(MAT_GENERAL);
+    ctx->kinds[ctx->mode] = mat_kind(ctx->cur_mat);
 }
 
 /********************
@@ -482,7 +1486,92 @@ sr_load_matrix(float* src)
 extern void
 sr_load_identity()
 {
-   *cur_mat = identity;
+    *ctx->cur_mat = identity;
+
+    touch(MAT_RIGID);
+    ctx->kinds[ctx->mode] = MAT_RIGID;
+}
+
+/******************
+ * others_changes *
+ ******************/
+
+/* changes made to every matrix but the current one, only ever grows */
+static uint32_t
+others_changes()
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < 4; i++)
+        if (i != (int)ctx->mode)
+            sum += ctx->changes[i];
+    return sum;
+}
+
+/******************
+ * sr_push_matrix *
+ ******************/
+
+/**
+ * saves the current matrix on its mode's stack together with the 
+ * data derived from it, returns 0 if the stack is full
+ */
+extern int
+sr_push_matrix()
+{
+    struct mat_stack* stack = ctx->stacks + ctx->mode;
+    if (stack->depth == SR_MAX_STACK_DEPTH)
+        return 0;
+
+    struct stack_entry* e = stack->entries + stack->depth++;
+
+    e->mat = *ctx->cur_mat;
+    e->mvp = ctx->mvp;
+    e->normal_transform = ctx->normal_transform;
+    memcpy(e->cam_pos, ctx->uniform.cam_pos, 3 * sizeof(float));
+    e->others = others_changes();
+    e->dirty = ctx->dirty;
+    e->kind = ctx->kinds[ctx->mode];
+
+    return 1;
+}
+
+/*****************
+ * sr_pop_matrix *
+ *****************/
+
+/**
+ * restores the matrix last pushed in the current mode, along with 
+ * the derived data that was up to date at the push, the mvp only 
+ * if no other matrix changed since, returns 0 if the stack is empty
+ */
+extern int
+sr_pop_matrix()
+{
+    struct mat_stack* stack = ctx->stacks + ctx->mode;
+    if (stack->depth == 0)
+        return 0;
+
+    struct stack_entry* e = stack->entries + --stack->depth;
+    uint8_t deps = mode_dirties[ctx->mode];
+
+    *ctx->cur_mat = e->mat;
+    ctx->kinds[ctx->mode] = e->kind;
+    ctx->changes[ctx->mode]++;
+
+    ctx->dirty = (ctx->dirty & ~deps) | (e->dirty & deps);
+
+    if (!(e->dirty & DIRTY_MVP) && e->others == others_changes())
+        ctx->mvp = e->mvp;
+    else
+        ctx->dirty |= DIRTY_MVP;
+
+    if ((deps & DIRTY_NORMAL) && !(e->dirty & DIRTY_NORMAL))
+        ctx->normal_transform = e->normal_transform;
+
+    if ((deps & DIRTY_CAM_POS) && !(e->dirty & DIRTY_CAM_POS))
+        memcpy(ctx->uniform.cam_pos, e->cam_pos, 3 * sizeof(float));
+
+    return 1;
 }
 
 /*********************************************************************
@@ -506,7 +1595,8 @@ sr_translate(float x, float y, float z)
         0, 0, 0, 1
     };
 
-    matmul(cur_mat, &t);
+    matmul(ctx->cur_mat, &t);
+    touch(MAT_RIGID);
 }
 
 /***************
@@ -527,7 +1617,8 @@ sr_rotate_x(float t)
         0,  0,  0,  1
     };
 
-    matmul(cur_mat, &x);
+    matmul(ctx->cur_mat, &x);
+    touch(MAT_RIGID);
 }
 
 /***************
@@ -549,7 +1640,8 @@ sr_rotate_y(float t)
         0,  0,  0,  1
     };
 
-    matmul(cur_mat, &y);
+    matmul(ctx->cur_mat, &y);
+    touch(MAT_RIGID);
 }
 
 /***************
@@ -571,7 +1663,8 @@ sr_rotate_z(float t)
         0,  0,  0,  1
     };
 
-    matmul(cur_mat, &z);
+    matmul(ctx->cur_mat, &z);
+    touch(MAT_RIGID);
 }
 
 /************
@@ -589,7 +1682,8 @@ sr_scale(float sx, float sy, float sz)
         0,  0,  0,  1
     };
 
-    matmul(cur_mat, &s);
+    matmul(ctx->cur_mat, &s);
+    touch(MAT_AFFINE);
 }
 
 /*********************************************************************
@@ -653,7 +1747,8 @@ sr_look_at(float ex, float ey, float ez,
         0,    0,    0,    1
     };
 
-    matmul(cur_mat, &m);
+    matmul(ctx->cur_mat, &m);
+    touch(MAT_RIGID);
     sr_translate(-ex, -ey, -ez);
 }
 
@@ -684,7 +1779,8 @@ sr_perspective(float fovy, float aspect, float near, float far)
         0,   0,   -1,    0
     };
 
-    matmul(cur_mat, &p);
+    matmul(ctx->cur_mat, &p);
+    touch(MAT_GENERAL);
 }
 
 /**************
@@ -711,5 +1807,6 @@ sr_frustum(float left, float right, float bottom,
         0,   0,   -1,    0
     };
 
-    matmul(cur_mat, &p);
+    matmul(ctx->cur_mat, &p);
+    touch(MAT_GENERAL);
 }
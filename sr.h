@@ -7,10 +7,17 @@
 
 #define SR_MAX_ATTRIBUTE_COUNT 32
 #define SR_MAX_LIGHT_COUNT 8
+#define SR_MAX_STACK_DEPTH 32
+#define SR_MESHLET_MAX_PTS 64
+#define SR_MESHLET_MAX_TRIS 124
+#define SR_MAX_LODS 4
+#define SR_MAX_SAMPLES 8
 
 #define SR_WINDING_ORDER_CCW 1
 #define SR_WINDING_ORDER_CW -1
 
+#define SR_PRIMITIVE_RESTART -1
+
 enum sr_clip_plane {
     SR_CLIP_LEFT_PLANE = 1 << 0,
     SR_CLIP_BOTTOM_PLANE = 1 << 1,
@@ -24,7 +31,8 @@ enum sr_primitive {
     SR_LINE_LIST,
     SR_LINE_STRIP,
     SR_TRIANGLE_LIST,
-    SR_TRIANGLE_STRIP
+    SR_TRIANGLE_STRIP,
+    SR_TRIANGLE_FAN
 };
 
 enum sr_matrix_mode {
@@ -76,24 +84,85 @@ enum sr_light_type {
 
 typedef void (*vs_f)(float* out, float* in, void* uniform);
 typedef void (*fs_f)(uint32_t* out, float* in, void* uniform);
+typedef void (*inst_f)(void* uniform, int instance_id);
 
 /******************
  * sr_framebuffer *
  ******************/
 
-/* interface to whatever writes to the screen */
+/**
+ * interface to whatever writes to the screen, with more than one 
+ * sample per pixel triangles draw into the sample buffers instead, 
+ * 'n_samples' entries per pixel, and sr_resolve averages them into 
+ * 'colors'
+ */
 
 struct sr_framebuffer {
     uint32_t* colors;
     float* depths;           
     int width; 
     int height;    
+    int n_samples;              /* 1, 2, 4 or 8, 0 counts as 1 */
+    uint32_t* sample_colors;
+    float* sample_depths;
+};
+
+/************
+ * sr_stats *
+ ************/
+
+/**
+ * running counts of primitives and where they left the pipeline,
+ * accumulated by every render call that is given one
+ */
+
+struct sr_stats {
+    int n_prims;                /* primitives assembled */
+    int n_frustum_culled;       /* entirely outside one clip plane */
+    int n_degenerate_culled;    /* zero area in clip space */
+    int n_backface_culled;      /* against winding order before clipping */
+    int n_winding_culled;       /* against winding order after clipping */
+    int n_sample_culled;        /* bounds contain no pixel center */
+    int n_meshlet_culled;       /* whole meshlets outside or facing away */
+    int n_draw_culled;          /* whole draws outside by their bounds */
+    int n_occlusion_culled;     /* whole draws hidden behind occluders */
 };
 
 /***************
  * sr_pipeline *
  ***************/
 
+/*************
+ * sr_format *
+ *************/
+
+/* storage of a stream's components, decoded to floats on fetch */
+
+enum sr_format {
+    SR_FORMAT_F32 = 0,
+    SR_FORMAT_F16,          /* ieee half precision */
+    SR_FORMAT_SNORM16,      /* int16_t, -32767 to 32767 maps to -1 to 1 */
+    SR_FORMAT_UNORM16       /* uint16_t, 0 to 65535 maps to 0 to 1 */
+};
+
+/*************
+ * sr_stream *
+ *************/
+
+/**
+ * one attribute stream of a separate streams vertex layout, the 
+ * vertex shader sees each point's streams back to back in the 
+ * order they were bound, decoded to floats, 'n_attr' summed over 
+ * streams must not exceed SR_MAX_ATTRIBUTE_COUNT
+ */
+
+struct sr_stream {
+    void* data;
+    enum sr_format format;
+    int n_attr;         /* components per point read from this stream */
+    int stride;         /* components from one point to the next, 0 if packed */
+};
+
 /**
  * stores all data required to pre-allocate
  * memory required to render an indexed list of
@@ -108,10 +177,62 @@ struct sr_pipeline {
     float* pts_in;
     int n_pts;
     int n_attr_in;
+    struct sr_stream* streams;  /* if any, read instead of pts_in */
+    int n_streams;
     int n_attr_out;
     int winding;
+    struct sr_stats* stats;    /* optional, may be null */
+};
+
+/***********
+ * sr_draw *
+ ***********/
+
+/* one record of a multi draw, reading a range of a shared index buffer */
+
+struct sr_draw {
+    int first_index;    /* offset into the index buffer */
+    int n_indices;
+    int base_vertex;    /* added to every index of this draw */
+    void* uniform;      /* null keeps the pipeline's uniform */
+};
+
+/**********
+ * sr_lod *
+ **********/
+
+/**
+ * one level of detail, a range of an index buffer shared by every 
+ * level, with how far it strays from the full mesh in model units
+ */
+
+struct sr_lod {
+    int first_index;
+    int n_indices;
+    float error;
 };
 
+/*********************************************************************
+ *                                                                   *
+ *                             contexts                              *
+ *                                                                   *
+ *********************************************************************/
+
+/**
+ * a context owns every piece of state the functions below act on, 
+ * each thread draws through its own current context so several 
+ * renderers can run at once, threads that never make one current 
+ * share a default context, a context current on another thread 
+ * isn't freed
+ */
+
+struct sr_context;
+
+struct sr_context* sr_context_create();
+int sr_context_free(struct sr_context* ctx);
+void sr_context_make_current(struct sr_context* ctx);
+struct sr_context* sr_context_current();
+
 /*********************************************************************
  *                                                                   *
  *                           render pipeline                         *
@@ -121,14 +242,89 @@ struct sr_pipeline {
 /* render interface */
 
 void sr_bind_vertices(float* pts, int n_pts, int n_attr);
+void sr_bind_streams(struct sr_stream* streams, int n_streams, int n_pts);
+void sr_bind_bounds(float* bounds);
 void sr_bind_framebuffer(int width, int height, uint32_t* colors, float* depths);
+int sr_bind_samples(int n_samples, uint32_t* colors, float* depths);
+void sr_resolvel();
 void sr_bind_uniform(void* uniform);
 void sr_restore_uniform();
 void sr_bind_texture(uint32_t* colors, int width, int height);
 void sr_bind_base_color(float r, float g, float b);
+void sr_bind_stats(struct sr_stats* stats);
 void sr_renderl(int* indices, int n_indices, enum sr_primitive prim_type);
+void sr_renderl_instanced(int* indices, int n_indices, 
+                          enum sr_primitive prim_type, 
+                          float* models, int n_instances);
+void sr_multi_draw(int* indices, struct sr_draw* draws, 
+                   int n_draws, enum sr_primitive prim_type);
+int sr_select_lod(struct sr_lod* lods, int n_lods);
+void sr_draw_lods(int* indices, struct sr_lod* lods, int n_lods);
 void sr_render(struct sr_pipeline* pipe, int* indices, 
                int n_indices, enum sr_primitive prim_type);
+void sr_render_instanced(struct sr_pipeline* pipe, int* indices, 
+                         int n_indices, enum sr_primitive prim_type,
+                         int n_instances, inst_f instance);
+void sr_render_multi(struct sr_pipeline* pipe, int* indices, 
+                     struct sr_draw* draws, int n_draws, 
+                     enum sr_primitive prim_type);
+void sr_resolve(struct sr_framebuffer* fbuf);
+
+/*********************************************************************
+ *                                                                   *
+ *                          command lists                            *
+ *                                                                   *
+ *********************************************************************/
+
+/**
+ * a command list records draws of the fixed pipeline's state with 
+ * their matrices and lights already resolved, to be replayed with 
+ * sr_submit as often as needed
+ */
+
+struct sr_cmd_list;
+
+struct sr_cmd_list* sr_cmd_list_create();
+void sr_cmd_list_free(struct sr_cmd_list* list);
+void sr_cmd_list_reset(struct sr_cmd_list* list);
+int sr_cmd_draw(struct sr_cmd_list* list, int* indices, 
+                int n_indices, enum sr_primitive prim_type);
+void sr_submit(struct sr_cmd_list** lists, int n_lists);
+
+/*********************************************************************
+ *                                                                   *
+ *                        occlusion culling                          *
+ *                                                                   *
+ *********************************************************************/
+
+/**
+ * a small depth buffer of occluders drawn with the current 
+ * matrices, once bound, draws with bounds hidden behind it are 
+ * skipped like those outside the frustum
+ */
+
+struct sr_occlusion;
+
+struct sr_occlusion* sr_occlusion_create(int width, int height);
+void sr_occlusion_free(struct sr_occlusion* occ);
+void sr_occlusion_clear(struct sr_occlusion* occ);
+void sr_occluder(struct sr_occlusion* occ, float* pts, int n_pts, 
+                 int n_attr, int* indices, int n_indices);
+void sr_bind_occlusion(struct sr_occlusion* occ);
+
+/*********************************************************************
+ *                                                                   *
+ *                         post processing                           *
+ *                                                                   *
+ *********************************************************************/
+
+/**
+ * fast approximate anti-aliasing over a finished frame's colors, 
+ * far cheaper than multisampling but softening texture detail too
+ */
+
+int sr_fxaa(struct sr_framebuffer* fbuf);
+int sr_fxaal();
 
 /*********************************************************************
  *                                                                   *
@@ -153,6 +349,8 @@ void sr_matrix_mode(enum sr_matrix_mode mode);
 void sr_dump_matrix(float* dest);
 void sr_load_matrix(float* src);
 void sr_load_identity();
+int sr_push_matrix();
+int sr_pop_matrix();
 void sr_perspective(float fovy, float aspect, float near, float far);
 void sr_frustum(float left, float right, float bottom, 
                 float top, float near, float far);
@@ -165,6 +363,117 @@ void sr_look_at(float ex, float ey, float ez,
                 float cx, float cy, float cz, 
                 float ux, float uy, float uz);
 
+/*********************************************************************
+ *                                                                   *
+ *                             file io                               *
+ *                                                                   *
+ *********************************************************************/
+
+/**********
+ * sr_obj *
+ **********/
+
+/**
+ * an indexed triangle list, points are x, y, z, u, v, nx, ny, nz, 
+ * when loaded from a cache 'pts' and 'indices' point into the 
+ * mapped cache file, which writes never reach
+ *
+ * 'indices' holds every level of detail back to back, the full 
+ * mesh first, coarser levels index the same points
+ */
+
+struct sr_obj {
+    float* pts;
+    int n_pts;
+    int n_attr;
+    int* indices;
+    int n_indices;      /* of the full mesh, the first level */
+    struct sr_lod lods[SR_MAX_LODS];
+    int n_lods;
+    float bounds[6];    /* min x, y, z then max x, y, z */
+    void* map;          /* private, the mapped cache or null */
+    size_t map_size;
+};
+
+struct sr_obj* sr_load_obj(char* file);
+void sr_obj_free(struct sr_obj* obj);
+
+/**************
+ * sr_texture *
+ **************/
+
+/* 32 bit argb texels, the top row first */
+
+struct sr_texture {
+    uint32_t* colors;
+    int width;
+    int height;
+};
+
+struct sr_texture* sr_load_tga(char* file);
+void sr_texture_free(struct sr_texture* texture);
+
+/*********************************************************************
+ *                                                                   *
+ *                        mesh optimization                          *
+ *                                                                   *
+ *********************************************************************/
+
+/**
+ * offline passes over indexed triangle lists: cache order, then 
+ * overdraw order, then fetch order, sr_optimize_obj runs all three, 
+ * and edge collapse simplification for coarser levels of detail
+ */
+
+int sr_optimize_vertex_cache(int* dest, int* indices, 
+                             int n_indices, int n_pts);
+int sr_optimize_overdraw(int* dest, int* indices, int n_indices, 
+                         float* pts, int n_pts, int n_attr, 
+                         float threshold);
+int sr_optimize_vertex_fetch(float* pts, int n_pts, int n_attr, 
+                             int* indices, int n_indices);
+int sr_optimize_obj(struct sr_obj* obj);
+int sr_simplify(int* dest, int* indices, int n_indices, float* pts, 
+                int n_pts, int n_attr, int target, float* error);
+
+/**************
+ * sr_meshlet *
+ **************/
+
+/**
+ * a run of a meshlet mesh's index buffer drawn as one unit, with a 
+ * bounding sphere to frustum cull it and a cone around its normals 
+ * to cull it when every triangle faces away, in model space
+ */
+
+struct sr_meshlet {
+    int first_index;
+    int n_indices;
+    int base_vertex;
+    float center[3];
+    float radius;
+    float cone_axis[3];
+    float cone_cutoff;      /* sine of the cone's half angle, 1 never culls */
+};
+
+/* a mesh rebuilt as meshlets, each with its own points */
+
+struct sr_meshlets {
+    float* pts;
+    int n_pts;
+    int n_attr;
+    int* indices;           /* relative to each meshlet's base vertex */
+    int n_indices;
+    struct sr_meshlet* meshlets;
+    int n_meshlets;
+};
+
+struct sr_meshlets* sr_build_meshlets(float* pts, int n_pts, int n_attr, 
+                                      int* indices, int n_indices);
+void sr_meshlets_free(struct sr_meshlets* ml);
+void sr_draw_meshlets(int* indices, struct sr_meshlet* meshlets, 
+                      int n_meshlets);
+
 /*********************************************************************
  *                                                                   *
  *                     prebuilt shader bindings                      *
@@ -81,11 +81,15 @@ struct raster {
     fs_f fs;
     int n_attr;
     int winding;
+    struct sr_stats* stats;    /* optional, may be null */
 };
 
 void draw_pt(struct raster* rast, float* pt);
 void draw_ln(struct raster* rast, float* v0, float* v1);
 void draw_tr(struct raster* rast, float* v0, float* v1, float* v2);
+void draw_tr_depth(float* depths, float* seams, uint8_t* opens, 
+                   int width, int height, float* v0, float* v1, float* v2, 
+                   int open_edges);
 
 /*********************************************************************
  *                                                                   *
@@ -95,7 +99,10 @@ void draw_tr(struct raster* rast, float* v0, float* v1, float* v2);
 
 void clip_poly(float* src, int* n_pts, 
                int n_attr, uint8_t clip_flags);
+void clip_line(float* src, int* n_pts, 
+               int n_attr, uint8_t clip_flags);
 void clip_test(float* pt, uint8_t* flags);
+void clip_test_batch(float* pts, int n_pts, int stride, uint8_t* flags);
 
 /*********************************************************************
  *                                                                   *
@@ -110,11 +117,23 @@ struct mat4 {
     float e30, e31, e32, e33;
 };
 
+/* what a matrix is known to be, each a special case of the one before */
+enum mat_kind {
+    MAT_GENERAL,
+    MAT_AFFINE,     /* bottom row is 0 0 0 1 */
+    MAT_RIGID       /* rotations and translations only */
+};
+
 void matmul(struct mat4* a, struct mat4* b);
 int invert(struct mat4* a);
+int invert_affine(struct mat4* a);
+void invert_rigid(struct mat4* a);
+int invert_as(struct mat4* a, enum mat_kind kind);
+enum mat_kind mat_kind(struct mat4* a);
 void transpose(struct mat4* a);
 void upper_3x3(struct mat4* a);
 void vec4_matmul(float* a, struct mat4* b, float* c);
+void vec4_matmul_n(float* a, struct mat4* b, float* c, int n, int stride);
 void vec4_mul(float* a, float* b, float* c);
 void vec4_add(float* a, float* b, float* c);
 void vec4_scale(float* a, float* b, float c);
@@ -127,4 +146,16 @@ float dot(float* a, float* b);
 void cross(float* a, float* b, float* c);
 float magnitude(float* a);
 void normalize(float* a);
-float radians(float deg);
\ No newline at end of file
+float radians(float deg);
+
+/*********************************************************************
+ *                                                                   *
+ *                             occlusion                             *
+ *                                                                   *
+ *********************************************************************/
+
+void occlusion_draw(struct sr_occlusion* occ, struct mat4* mvp, 
+                    float* pts, int n_pts, int n_attr, 
+                    int* indices, int n_indices);
+int occlusion_test(struct sr_occlusion* occ, struct mat4* mvp, 
+                   float* bounds);
@@ -0,0 +1,193 @@
+
+#include "unity.h"
+#include "clip.c"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*********************************************************************
+ *                                                                   *
+ *                          unity helpers                            *
+ *                                                                   *
+ *********************************************************************/
+
+void 
+setUp() 
+{
+    /* empty */
+}
+
+void 
+tearDown() 
+{
+    /* empty */
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                            base cases                             *
+ *                                                                   *
+ *********************************************************************/
+
+/****************
+ * ln_contained *
+ ****************/
+
+/* the line is entirely within the bounding box */
+void
+ln_contained()
+{
+    float src[2 * 5] = {
+        -0.5, 0, 0, 1, 3,
+        0.5, 0.5, 0, 1, 7
+    };
+
+    float ans[2 * 5] = {
+        -0.5, 0, 0, 1, 3,
+        0.5, 0.5, 0, 1, 7
+    };
+
+    int num_pts = 2;
+
+    clip_line(src, &num_pts, 5, 0);
+    TEST_ASSERT_EQUAL_INT(2, num_pts);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(ans, src, 2 * 5);
+}
+
+/**************
+ * ln_outside *
+ **************/
+
+/* both points beyond the right plane, nothing is left */
+void
+ln_outside()
+{
+    float src[2 * 4] = {
+        2, 0, 0, 1,
+        3, 0.5, 0, 1
+    };
+
+    int num_pts = 2;
+
+    clip_line(src, &num_pts, 4, SR_CLIP_RIGHT_PLANE);
+    TEST_ASSERT_EQUAL_INT(0, num_pts);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                          intersections                            *
+ *                                                                   *
+ *********************************************************************/
+
+/**********************
+ * ln_intersects_left *
+ **********************/
+
+/* the start of the line is cut at the left plane, attributes follow */
+void
+ln_intersects_left()
+{
+    float src[2 * 5] = {
+        -3, 0, 0, 1, 0,
+        1, 0, 0, 1, 4
+    };
+
+    float ans[2 * 5] = {
+        -1, 0, 0, 1, 2,
+        1, 0, 0, 1, 4
+    };
+
+    int num_pts = 2;
+
+    clip_line(src, &num_pts, 5, SR_CLIP_LEFT_PLANE);
+    TEST_ASSERT_EQUAL_INT(2, num_pts);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(ans, src, 2 * 5);
+}
+
+/**********************
+ * ln_intersects_both *
+ **********************/
+
+/* the line crosses the box, cut at the bottom and the top */
+void
+ln_intersects_both()
+{
+    float src[2 * 4] = {
+        0, -3, 0, 1,
+        0, 5, 0, 1
+    };
+
+    float ans[2 * 4] = {
+        0, -1, 0, 1,
+        0, 1, 0, 1
+    };
+
+    int num_pts = 2;
+
+    clip_line(src, &num_pts, 4, SR_CLIP_BOTTOM_PLANE | SR_CLIP_TOP_PLANE);
+    TEST_ASSERT_EQUAL_INT(2, num_pts);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(ans, src, 2 * 4);
+}
+
+/*****************
+ * ln_near_plane *
+ *****************/
+
+/* homogeneous cut at the near plane, where w differs at each end */
+void
+ln_near_plane()
+{
+    float src[2 * 4] = {
+        0, 0, -3, 1,
+        0, 0, 2, 3
+    };
+
+    float ans[2 * 4] = {
+        0, 0, -1.571429, 1.571429,
+        0, 0, 2, 3
+    };
+
+    int num_pts = 2;
+
+    clip_line(src, &num_pts, 4, SR_CLIP_NEAR_PLANE);
+    TEST_ASSERT_EQUAL_INT(2, num_pts);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(ans, src, 2 * 4);
+}
+
+/********************
+ * ln_misses_corner *
+ ********************/
+
+/* the line passes outside a corner, each end inside one of the planes */
+void
+ln_misses_corner()
+{
+    float src[2 * 4] = {
+        0, 3, 0, 1,
+        3, 0, 0, 1
+    };
+
+    int num_pts = 2;
+
+    clip_line(src, &num_pts, 4, SR_CLIP_RIGHT_PLANE | SR_CLIP_TOP_PLANE);
+    TEST_ASSERT_EQUAL_INT(0, num_pts);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                              main                                 *
+ *                                                                   *
+ *********************************************************************/
+
+int
+main() 
+{
+    UNITY_BEGIN();
+    RUN_TEST(ln_contained);
+    RUN_TEST(ln_outside);
+    RUN_TEST(ln_intersects_left);
+    RUN_TEST(ln_intersects_both);
+    RUN_TEST(ln_near_plane);
+    RUN_TEST(ln_misses_corner);
+    return UNITY_END();
+}
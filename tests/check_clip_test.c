@@ -189,6 +189,47 @@ on_corner()
     TEST_ASSERT_EQUAL_UINT8(0, clip_flag);
 }
 
+/*********************************************************************
+ *                                                                   *
+ *                              batches                              *
+ *                                                                   *
+ *********************************************************************/
+
+/**************
+ * batch_tail *
+ **************/
+
+/**
+ * a batch that isn't a multiple of eight, strided like vertex
+ * shader output, agrees with the single point test
+ */
+void
+batch_tail()
+{
+    float pts[11 * 5] = {
+        0, 0, 0, 1, 9,
+        -2, 0, 0, 1, 9,
+        0, -2, 0, 1, 9,
+        0, 0, -2, 1, 9,
+        2, 0, 0, 1, 9,
+        0, 2, 0, 1, 9,
+        -3, 2, 0, 1, 9,
+        0, -11, -2, 1, 9,
+        1, 1, 1, 1, 9,
+        5, 5, 5, 1, 9,
+        -1, -1, -1, 1, 9
+    };
+
+    uint8_t clip_flags[11];
+    memset(clip_flags, 0xAA, 11);
+    clip_test_batch(pts, 11, 5, clip_flags);
+
+    for (int i = 0; i < 11; i++) {
+        uint8_t clip_flag;
+        clip_test(pts + i * 5, &clip_flag);
+        TEST_ASSERT_EQUAL_UINT8(clip_flag, clip_flags[i]);
+    }
+}
 
 /*********************************************************************
  *                                                                   *
@@ -209,6 +250,7 @@ main()
     RUN_TEST(top_and_left);
     RUN_TEST(bottom_and_near);
     RUN_TEST(on_corner);
+    RUN_TEST(batch_tail);
 
     return UNITY_END();
 }
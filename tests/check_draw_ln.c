@@ -0,0 +1,265 @@
+
+#include "unity.h"
+#include "rast.c"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*********************************************************************
+ *                                                                   *
+ *                           declarations                            *
+ *                                                                   *
+ *********************************************************************/
+
+static void fs_attr(uint32_t* color_p, float* pt, void* uniform);
+static void fs_color( uint32_t* color_p, float* pt, void* uniform);
+
+/*********************************************************************
+ *                                                                   *
+ *                        setup raster data                          *
+ *                                                                   *
+ *********************************************************************/
+
+uint32_t g_color;
+uint32_t g_colors[6 * 10];
+float g_depths[6 * 10];
+
+struct sr_framebuffer g_fbuf = {
+    .width = 10, 
+    .height = 6, 
+    .colors = g_colors, 
+    .depths = g_depths
+};
+
+struct raster_context g_rast = {
+    .fbuf = &g_fbuf,
+    .uniform = &g_color, 
+    .winding = SR_WINDING_ORDER_CCW,
+    .fs = (fs_f)fs_color, 
+    .n_attr = 4
+};
+
+/*********************************************************************
+ *                                                                   *
+ *                   fragment shader definitions                     *
+ *                                                                   *
+ *********************************************************************/
+
+/* whatever is in the fourth attribute slot is the 'color' */
+
+static void
+fs_attr(uint32_t* color_p, float* pt, void* uniform) 
+{
+    (*color_p) = pt[4];
+}
+
+/* the uniform data becomes the 'color' */
+
+static void 
+fs_color(uint32_t* color_p, float* pt, void* uniform)
+{
+    (*color_p) = *((uint32_t*)(uniform));
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                           unity helpers                           *
+ *                                                                   *
+ *********************************************************************/
+void 
+setUp() 
+{
+    /* clear framebuffer */
+    memset(g_colors, 0, sizeof(uint32_t) * 6 * 10);
+    for (int i = 0; i < 6 * 10; i++) {
+        g_depths[i] = 1000;
+    }
+    /* set default color to 1 */
+    g_color = 1;
+    g_rast.fs = (fs_f)fs_color;
+    g_rast.n_attr = 4;
+}
+
+void 
+tearDown() 
+{
+    /* empty */
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             coverage                              *
+ *                                                                   *
+ *********************************************************************/
+
+/*******************
+ * horizontal_line *
+ *******************/
+
+/* every center crossed is lit, except the one at the end point */
+
+void 
+horizontal_line() 
+{
+    float ln[2 * 4] = {
+        0.5, 1.5, 1, 1,         /* v0 */
+        5.5, 1.5, 1, 1          /* v1 */
+    };
+
+    draw_ln(&g_rast, ln, ln + 4);
+
+    uint32_t target_colors[6 * 10] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_rast.fbuf->colors, 6 * 10);
+}
+
+/**************
+ * steep_line *
+ **************/
+
+/* y is the major axis, drawn from the end point back to the start */
+
+void 
+steep_line() 
+{
+    float ln[2 * 4] = {
+        3.0, 4.0, 1, 1,         /* v0 */
+        1.0, 0.0, 1, 1          /* v1 */
+    };
+
+    draw_ln(&g_rast, ln, ln + 4);
+
+    uint32_t target_colors[6 * 10] = {
+        0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 1, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 1, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 1, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_rast.fbuf->colors, 6 * 10);
+}
+
+/******************
+ * offscreen_line *
+ ******************/
+
+/* centers past the framebuffer edges are never written */
+
+void 
+offscreen_line() 
+{
+    float ln[2 * 4] = {
+        -3.0, 5.5, 1, 1,        /* v0 */
+        14.0, 5.5, 1, 1         /* v1 */
+    };
+
+    draw_ln(&g_rast, ln, ln + 4);
+
+    uint32_t target_colors[6 * 10] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+    };
+
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_rast.fbuf->colors, 6 * 10);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                      interpolation & depth                        *
+ *                                                                   *
+ *********************************************************************/
+
+/*****************
+ * attr_varied_w *
+ *****************/
+
+/* attributes are weighted by 1 / w, not spread evenly in screen space */
+
+void 
+attr_varied_w() 
+{
+    g_rast.fs = (fs_f)fs_attr;
+    g_rast.n_attr = 5;
+
+    float ln[2 * 5] = {
+        0.5, 0.5, 1, 1, 0,          /* v0, w = 1 */
+        4.5, 0.5, 1, 0.25, 100      /* v1, w = 4 */
+    };
+
+    draw_ln(&g_rast, ln, ln + 5);
+
+    uint32_t target_colors[6 * 10] = {
+        0, 7, 20, 42, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_rast.fbuf->colors, 6 * 10);
+}
+
+/****************
+ * depth_behind *
+ ****************/
+
+/* pixels already holding something nearer keep their color */
+
+void 
+depth_behind() 
+{
+    g_colors[12] = 2;
+    g_depths[12] = 0.5;
+    g_colors[13] = 2;
+    g_depths[13] = 0.5;
+
+    float ln[2 * 4] = {
+        0.5, 1.5, 1, 1,         /* v0 */
+        6.5, 1.5, 1, 1          /* v1 */
+    };
+
+    draw_ln(&g_rast, ln, ln + 4);
+
+    uint32_t target_colors[6 * 10] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 2, 2, 1, 1, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_rast.fbuf->colors, 6 * 10);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                               main                                *
+ *                                                                   *
+ *********************************************************************/
+
+int 
+main() 
+{
+    UNITY_BEGIN();
+    RUN_TEST(horizontal_line);
+    RUN_TEST(steep_line);
+    RUN_TEST(offscreen_line);
+    RUN_TEST(attr_varied_w);
+    RUN_TEST(depth_behind);
+    return UNITY_END();
+}
@@ -14,6 +14,7 @@
 
 static void fs_attr(uint32_t* color_p, float* pt, void* uniform);
 static void fs_color( uint32_t* color_p, float* pt, void* uniform);
+static void fs_count(uint32_t* color_p, float* pt, void* uniform);
 
 /*********************************************************************
  *                                                                   *
@@ -24,6 +25,9 @@ static void fs_color( uint32_t* color_p, float* pt, void* uniform);
 uint32_t g_color;
 uint32_t g_colors[6 * 10];
 float g_depths[6 * 10];
+uint32_t g_sample_colors[6 * 10 * 4];
+float g_sample_depths[6 * 10 * 4];
+int g_n_shaded;
 
 struct sr_framebuffer g_fbuf = {
     .width = 10, 
@@ -62,6 +66,15 @@ fs_color(uint32_t* color_p, float* pt, void* uniform)
     (*color_p) = *((uint32_t*)(uniform));
 }
 
+/* the uniform's color, counting every call */
+
+static void 
+fs_count(uint32_t* color_p, float* pt, void* uniform)
+{
+    (*color_p) = *((uint32_t*)(uniform));
+    g_n_shaded++;
+}
+
 /*********************************************************************
  *                                                                   *
  *                           unity helpers                           *
@@ -75,6 +88,15 @@ setUp()
     for (int i = 0; i < 6 * 10; i++) {
         g_depths[i] = 1000;
     }
+    /* single sampled unless a test turns it on */
+    memset(g_sample_colors, 0, sizeof(g_sample_colors));
+    for (int i = 0; i < 6 * 10 * 4; i++) {
+        g_sample_depths[i] = 1000;
+    }
+    g_fbuf.n_samples = 0;
+    g_fbuf.sample_colors = g_sample_colors;
+    g_fbuf.sample_depths = g_sample_depths;
+    g_n_shaded = 0;
     /* set default color to 1 */
     g_color = 1;
     g_rast.fs = (fs_f)fs_color;
@@ -193,6 +215,59 @@ fill_too_small()
     TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_rast.fbuf->colors, 6 * 10);
 }
 
+/**********************
+ * fill_sample_culled *
+ **********************/
+
+/* triangles holding no pixel center are counted and never shaded */
+
+void 
+fill_sample_culled() 
+{
+    struct sr_stats stats = {0};
+    g_rast.stats = &stats;
+
+    float tr[3 * 4] = {
+        3.4, 1.6, 1, 1,         /* v0 */
+        2.6, 2.4, 1, 1,         /* v1 */
+        3.3, 2.3, 1, 1          /* v2 */
+    };
+
+    draw_tr(&g_rast, tr, tr + 4, tr + 8);
+    g_rast.stats = NULL;
+
+    TEST_ASSERT_EQUAL_INT(1, stats.n_sample_culled);
+}
+
+/*******************
+ * fill_one_pixel *
+ *******************/
+
+/* a sliver around a single pixel center takes the small path */
+
+void 
+fill_one_pixel() 
+{
+    float tr[3 * 4] = {
+        3.2, 1.2, 1, 1,         /* v0 */
+        3.3, 1.9, 1, 1,         /* v1 */
+        3.9, 1.3, 1, 1          /* v2 */
+    };
+
+    draw_tr(&g_rast, tr, tr + 4, tr + 8);
+
+    uint32_t target_colors[6 * 10] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_rast.fbuf->colors, 6 * 10);
+}
+
 /*******************
  * fill_on_centers *
  *******************/
@@ -691,6 +766,152 @@ depth_varied()
     TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_rast.fbuf->colors, 6 * 10);
 }
 
+/*********************************************************************
+ *                                                                   *
+ *                          multisampling                            *
+ *                                                                   *
+ *********************************************************************/
+
+/*************
+ * msaa_quad *
+ *************/
+
+/* the two triangles of the quad from x0 to x1 over the whole height */
+
+static void
+msaa_quad(float x0, float x1, float Z)
+{
+    float tr1[3 * 4] = {
+        x0, 6.0, 1.0, Z,            /* v0 */
+        x1, 0.0, 1.0, Z,            /* v1 */
+        x0, 0.0, 1.0, Z             /* v2 */
+    };
+
+    float tr2[3 * 4] = {
+        x1, 6.0, 1.0, Z,            /* v0 */
+        x1, 0.0, 1.0, Z,            /* v1 */
+        x0, 6.0, 1.0, Z             /* v2 */
+    };
+
+    draw_tr(&g_rast, tr1, tr1 + 4, tr1 + 8);
+    draw_tr(&g_rast, tr2, tr2 + 4, tr2 + 8);
+}
+
+/*************
+ * msaa_edge *
+ *************/
+
+/**
+ * an edge through the middle of a column covers the samples left of 
+ * it, the two samples of the pattern at -2 / 16 and -6 / 16
+ */
+
+void
+msaa_edge()
+{
+    g_fbuf.n_samples = 4;
+    msaa_quad(0, 2.5, 1);
+
+    uint32_t left[4] = {1, 1, 1, 1};
+    uint32_t half[4] = {1, 0, 1, 0};
+    uint32_t none[4] = {0, 0, 0, 0};
+
+    for (int y = 0; y < 6; y++) {
+        uint32_t* samples = g_sample_colors + y * 10 * 4;
+        TEST_ASSERT_EQUAL_UINT32_ARRAY(left, samples, 4);
+        TEST_ASSERT_EQUAL_UINT32_ARRAY(left, samples + 4, 4);
+        TEST_ASSERT_EQUAL_UINT32_ARRAY(half, samples + 8, 4);
+        TEST_ASSERT_EQUAL_UINT32_ARRAY(none, samples + 12, 4);
+    }
+
+    /* the framebuffer's own buffers are left alone */
+
+    uint32_t target_colors[6 * 10] = {0};
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_colors, 6 * 10);
+}
+
+/*******************
+ * msaa_shade_once *
+ *******************/
+
+/**
+ * a triangle shades once in each pixel it reaches, however many 
+ * samples it covers there
+ */
+
+void
+msaa_shade_once()
+{
+    g_fbuf.n_samples = 4;
+    g_rast.fs = (fs_f)fs_count;
+
+    float tr[3 * 4] = {
+        2.5, 1.15, 1, 1,         /* v0 */
+        1.2, 2.73, 1, 1,         /* v1 */
+        4.0, 4.0, 1, 1           /* v2 */
+    };
+
+    draw_tr(&g_rast, tr, tr + 4, tr + 8);
+
+    int n_pixels = 0;
+    int n_samples = 0;
+    for (int i = 0; i < 6 * 10; i++) {
+        int any = 0;
+        for (int s = 0; s < 4; s++) {
+            any |= g_sample_colors[4 * i + s];
+            n_samples += g_sample_colors[4 * i + s];
+        }
+        n_pixels += any;
+    }
+
+    TEST_ASSERT_EQUAL_INT(n_pixels, g_n_shaded);
+    TEST_ASSERT_TRUE(n_samples > n_pixels);
+}
+
+/**************
+ * msaa_depth *
+ **************/
+
+/* each sample keeps its own nearest surface, pixels can mix them */
+
+void
+msaa_depth()
+{
+    g_fbuf.n_samples = 4;
+    msaa_quad(0, 2.5, 1);           /* near, 1 / w of 1 */
+
+    g_color = 2;
+    msaa_quad(0, 10, 0.5);          /* far behind it */
+
+    uint32_t near[4] = {1, 1, 1, 1};
+    uint32_t mixed[4] = {1, 2, 1, 2};
+    uint32_t far[4] = {2, 2, 2, 2};
+
+    uint32_t* samples = g_sample_colors + 3 * 10 * 4;
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(near, samples + 4, 4);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(mixed, samples + 8, 4);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(far, samples + 12, 4);
+
+    TEST_ASSERT_EQUAL_FLOAT(1, g_sample_depths[(3 * 10 + 2) * 4]);
+    TEST_ASSERT_EQUAL_FLOAT(2, g_sample_depths[(3 * 10 + 2) * 4 + 1]);
+}
+
+/******************
+ * msaa_bad_count *
+ ******************/
+
+/* a count with no sample pattern draws nothing rather than guess */
+
+void
+msaa_bad_count()
+{
+    g_fbuf.n_samples = 3;
+    msaa_quad(0, 10, 1);
+
+    uint32_t none[6 * 10 * 4] = {0};
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(none, g_sample_colors, 6 * 10 * 4);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(none, g_colors, 6 * 10);
+}
 
 /*********************************************************************
  *                                                                   *
@@ -707,6 +928,8 @@ main()
     RUN_TEST(degenerate_triangle);
     /* fill rules */
     RUN_TEST(fill_too_small);
+    RUN_TEST(fill_sample_culled);
+    RUN_TEST(fill_one_pixel);
     RUN_TEST(fill_on_centers);
     RUN_TEST(fill_two_right_edges);
     RUN_TEST(fill_joined_triangles);
@@ -722,5 +945,10 @@ main()
     RUN_TEST(depth_same);
     RUN_TEST(depth_complete_overlap);
     RUN_TEST(depth_varied);
+    /* several samples per pixel */
+    RUN_TEST(msaa_edge);
+    RUN_TEST(msaa_shade_once);
+    RUN_TEST(msaa_depth);
+    RUN_TEST(msaa_bad_count);
     return UNITY_END();
 }
@@ -0,0 +1,708 @@
+
+#include "unity.h"
+#include "sr.c"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+/*********************************************************************
+ *                                                                   *
+ *                           unity helpers                           *
+ *                                                                   *
+ *********************************************************************/
+
+uint32_t g_colors[10 * 10];
+float g_depths[10 * 10];
+
+/* a triangle in the lower left quarter, each point carrying a color */
+float g_pts[5 * 3] = {
+    -0.8, -0.8, 0, 1, 1,
+     0.0, -0.8, 0, 1, 1,
+    -0.8,  0.0, 0, 1, 1
+};
+int g_indices[3] = {0, 1, 2};
+
+struct sr_context* g_ctx;
+
+/* transforms by the fixed uniform's mvp, passes the color through */
+static void
+vs_mvp(float* out, float* in, void* uniform)
+{
+    struct sr_uniform* u = uniform;
+    vec4_matmul(out, u->mvp, in);
+    out[4] = in[4];
+}
+
+static void
+fs_color(uint32_t* out, float* in, void* uniform)
+{
+    *out = roundf(in[4]);
+}
+
+static void
+clear()
+{
+    memset(g_colors, 0, sizeof(g_colors));
+    for (int i = 0; i < 10 * 10; i++)
+        g_depths[i] = 100000;
+}
+
+/* binds the triangle and buffers to the current context */
+static void
+bind_all()
+{
+    sr_bind_framebuffer(10, 10, g_colors, g_depths);
+    sr_bind_pts(g_pts, 3, 5);
+    sr_bind_vs(vs_mvp, 5);
+    sr_bind_fs(fs_color);
+}
+
+/* every entry of 'actual' near that of 'expected' */
+static void
+assert_mat(struct mat4* expected, struct mat4* actual)
+{
+    float* e = (float*)expected;
+    float* a = (float*)actual;
+    for (int i = 0; i < 16; i++)
+        TEST_ASSERT_FLOAT_WITHIN(1e-4, e[i], a[i]);
+}
+
+void
+setUp()
+{
+    clear();
+    g_ctx = sr_context_create();
+    sr_context_make_current(g_ctx);
+    bind_all();
+}
+
+void
+tearDown()
+{
+    sr_context_make_current(0);
+    sr_context_free(g_ctx);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                          command lists                            *
+ *                                                                   *
+ *********************************************************************/
+
+/**********************
+ * replay_matches_now *
+ **********************/
+
+/**
+ * a recorded draw replays to the pixels the same draw makes right
+ * away, with the matrices it was recorded under, not later ones
+ */
+
+void
+replay_matches_now()
+{
+    sr_translate(0.8, 0.8, 0);
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+
+    uint32_t now[10 * 10];
+    memcpy(now, g_colors, sizeof(now));
+    TEST_ASSERT_EQUAL_HEX32(1, now[3 * 10 + 6]);
+    TEST_ASSERT_EQUAL_HEX32(0, now[8 * 10 + 1]);
+    clear();
+
+    struct sr_cmd_list* list = sr_cmd_list_create();
+    TEST_ASSERT_EQUAL_INT(1, sr_cmd_draw(list, g_indices, 3,
+                                         SR_TRIANGLE_LIST));
+
+    sr_load_identity();
+    sr_submit(&list, 1);
+
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(now, g_colors, 10 * 10);
+
+    /* and again, as a list is replayed every frame */
+    clear();
+    sr_submit(&list, 1);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(now, g_colors, 10 * 10);
+
+    sr_cmd_list_free(list);
+}
+
+/***************************
+ * submit_restores_uniform *
+ ***************************/
+
+/* the context's own uniform points back at its own matrices after */
+
+void
+submit_restores_uniform()
+{
+    sr_translate(0.5, 0, 0);
+
+    struct sr_cmd_list* list = sr_cmd_list_create();
+    sr_cmd_draw(list, g_indices, 3, SR_TRIANGLE_LIST);
+    sr_load_identity();
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+
+    struct sr_uniform before = g_ctx->uniform;
+    sr_submit(&list, 1);
+
+    TEST_ASSERT_EQUAL_PTR(&g_ctx->model, g_ctx->uniform.model);
+    TEST_ASSERT_EQUAL_PTR(&g_ctx->mvp, g_ctx->uniform.mvp);
+    TEST_ASSERT_EQUAL_PTR(&g_ctx->normal_transform,
+                          g_ctx->uniform.normal_transform);
+    TEST_ASSERT_EQUAL_PTR(g_ctx->lights, g_ctx->uniform.lights);
+    TEST_ASSERT_EQUAL_PTR(&g_ctx->material, g_ctx->uniform.material);
+    TEST_ASSERT_EQUAL_MEMORY(&before, &g_ctx->uniform, sizeof(before));
+
+    sr_cmd_list_free(list);
+}
+
+/*****************
+ * shared_states *
+ *****************/
+
+/**
+ * draws under the same lights and material share one snapshot, a
+ * change in between takes another, and a reset forgets them all
+ */
+
+void
+shared_states()
+{
+    struct sr_cmd_list* list = sr_cmd_list_create();
+
+    sr_cmd_draw(list, g_indices, 3, SR_TRIANGLE_LIST);
+    sr_translate(0.2, 0, 0);
+    sr_cmd_draw(list, g_indices, 3, SR_TRIANGLE_LIST);
+    TEST_ASSERT_EQUAL_INT(2, list->n_draws);
+    TEST_ASSERT_EQUAL_INT(1, list->n_states);
+
+    float red[4] = {1, 0, 0, 1};
+    sr_material(SR_DIFFUSE, red);
+    sr_cmd_draw(list, g_indices, 3, SR_TRIANGLE_LIST);
+    TEST_ASSERT_EQUAL_INT(2, list->n_states);
+    TEST_ASSERT_EQUAL_INT(1, list->draws[2].state);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(red, list->states[1].material.diffuse, 4);
+
+    sr_cmd_list_reset(list);
+    TEST_ASSERT_EQUAL_INT(0, list->n_draws);
+    TEST_ASSERT_EQUAL_INT(0, list->n_states);
+
+    sr_cmd_list_free(list);
+}
+
+/****************
+ * unbound_draw *
+ ****************/
+
+/* nothing is recorded without shaders to draw it with */
+
+void
+unbound_draw()
+{
+    struct sr_cmd_list* list = sr_cmd_list_create();
+
+    sr_bind_fs(0);
+    TEST_ASSERT_EQUAL_INT(0, sr_cmd_draw(list, g_indices, 3,
+                                         SR_TRIANGLE_LIST));
+    TEST_ASSERT_EQUAL_INT(0, list->n_draws);
+
+    sr_cmd_list_free(list);
+}
+
+/***********************
+ * occlusion_on_submit *
+ ***********************/
+
+/**
+ * a draw behind the occluders is still recorded, and skipped only
+ * on the submits made while they hide it
+ */
+
+void
+occlusion_on_submit()
+{
+    struct sr_stats stats = {0};
+    sr_bind_stats(&stats);
+
+    sr_matrix_mode(SR_PROJECTION_MATRIX);
+    sr_frustum(-1, 1, -1, 1, 1, 100);
+    sr_matrix_mode(SR_MODEL_MATRIX);
+
+    /* a wall at depth 5 hiding a box around the triangle at 15 to 20 */
+
+    float wall[4 * 3] = {
+        -20, -20, -5,  20, -20, -5,  20, 20, -5,  -20, 20, -5
+    };
+    int quad[6] = {0, 1, 2, 0, 2, 3};
+    struct sr_occlusion* occ = sr_occlusion_create(16, 16);
+    sr_occluder(occ, wall, 4, 3, quad, 6);
+    sr_bind_occlusion(occ);
+
+    float bounds[6] = {-1, -1, -20, 1, 1, -15};
+    sr_bind_bounds(bounds);
+
+    struct sr_cmd_list* list = sr_cmd_list_create();
+    TEST_ASSERT_EQUAL_INT(1, sr_cmd_draw(list, g_indices, 3,
+                                         SR_TRIANGLE_LIST));
+    TEST_ASSERT_EQUAL_INT(1, list->n_draws);
+    TEST_ASSERT_EQUAL_INT(0, stats.n_occlusion_culled);
+
+    sr_submit(&list, 1);
+    TEST_ASSERT_EQUAL_INT(1, stats.n_occlusion_culled);
+    TEST_ASSERT_EQUAL_INT(0, stats.n_prims);
+
+    /* the wall gone, the same list draws */
+    sr_occlusion_clear(occ);
+    sr_submit(&list, 1);
+    TEST_ASSERT_EQUAL_INT(1, stats.n_occlusion_culled);
+    TEST_ASSERT_EQUAL_INT(1, stats.n_prims);
+
+    sr_bind_occlusion(0);
+    sr_occlusion_free(occ);
+    sr_cmd_list_free(list);
+}
+
+/********************
+ * bind_bad_samples *
+ ********************/
+
+/* only counts with a sample pattern bind, others keep the last */
+
+void
+bind_bad_samples()
+{
+    uint32_t colors[10 * 10 * 4];
+    float depths[10 * 10 * 4];
+
+    TEST_ASSERT_EQUAL_INT(1, sr_bind_samples(4, colors, depths));
+
+    int counts[5] = {0, 3, 6, 16, -2};
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL_INT(0, sr_bind_samples(counts[i], 0, 0));
+        TEST_ASSERT_EQUAL_INT(4, g_ctx->fbuf.n_samples);
+        TEST_ASSERT_EQUAL_PTR(colors, g_ctx->fbuf.sample_colors);
+        TEST_ASSERT_EQUAL_PTR(depths, g_ctx->fbuf.sample_depths);
+    }
+
+    TEST_ASSERT_EQUAL_INT(1, sr_bind_samples(1, 0, 0));
+    TEST_ASSERT_EQUAL_INT(1, g_ctx->fbuf.n_samples);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             contexts                              *
+ *                                                                   *
+ *********************************************************************/
+
+/* one thread's renderer, drawing the triangle shifted right by 'dx' */
+struct renderer {
+    float dx;
+    uint32_t colors[10 * 10];
+    float depths[10 * 10];
+    struct sr_context* started_on;
+};
+
+static void*
+render_thread(void* arg)
+{
+    struct renderer* r = arg;
+    r->started_on = sr_context_current();
+
+    struct sr_context* c = sr_context_create();
+    sr_context_make_current(c);
+    sr_bind_framebuffer(10, 10, r->colors, r->depths);
+    sr_bind_pts(g_pts, 3, 5);
+    sr_bind_vs(vs_mvp, 5);
+    sr_bind_fs(fs_color);
+
+    /* long enough for the threads to interleave */
+    for (int i = 0; i < 500; i++) {
+        memset(r->colors, 0, sizeof(r->colors));
+        for (int j = 0; j < 10 * 10; j++)
+            r->depths[j] = 100000;
+
+        sr_load_identity();
+        sr_translate(r->dx, 0, 0);
+        sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+    }
+
+    sr_context_make_current(0);
+    sr_context_free(c);
+    return 0;
+}
+
+/***************
+ * two_threads *
+ ***************/
+
+/**
+ * two threads drawing through their own contexts at once each get
+ * what they would alone, and new threads start on the default
+ */
+
+void
+two_threads()
+{
+    struct renderer r[2] = {{.dx = 0}, {.dx = 0.8}};
+    pthread_t threads[2];
+
+    for (int i = 0; i < 2; i++)
+        pthread_create(threads + i, 0, render_thread, r + i);
+
+    for (int i = 0; i < 2; i++) {
+        pthread_join(threads[i], 0);
+        TEST_ASSERT_EQUAL_PTR(&g_default_ctx, r[i].started_on);
+
+        clear();
+        sr_load_identity();
+        sr_translate(r[i].dx, 0, 0);
+        sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+        TEST_ASSERT_EQUAL_HEX32_ARRAY(g_colors, r[i].colors, 10 * 10);
+    }
+
+    /* the main thread's own context was never touched by them */
+    TEST_ASSERT_EQUAL_PTR(g_ctx, sr_context_current());
+    TEST_ASSERT_EQUAL_INT(1, g_ctx->n_current);
+}
+
+/* holds a context current until told to let go */
+struct holder {
+    struct sr_context* c;
+    pthread_barrier_t* barrier;
+};
+
+static void*
+hold_thread(void* arg)
+{
+    struct holder* h = arg;
+    sr_context_make_current(h->c);
+    pthread_barrier_wait(h->barrier);   /* it's current */
+    pthread_barrier_wait(h->barrier);   /* main tried to free it */
+    sr_context_make_current(0);
+    return 0;
+}
+
+/**************************
+ * free_current_elsewhere *
+ **************************/
+
+/* a context another thread draws with isn't freed until it lets go */
+
+void
+free_current_elsewhere()
+{
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, 0, 2);
+
+    struct holder h = {.c = sr_context_create(), .barrier = &barrier};
+    pthread_t thread;
+    pthread_create(&thread, 0, hold_thread, &h);
+
+    pthread_barrier_wait(&barrier);
+    TEST_ASSERT_EQUAL_INT(0, sr_context_free(h.c));
+    TEST_ASSERT_EQUAL_INT(1, h.c->n_current);
+    pthread_barrier_wait(&barrier);
+
+    pthread_join(thread, 0);
+    TEST_ASSERT_EQUAL_INT(0, h.c->n_current);
+    TEST_ASSERT_EQUAL_INT(1, sr_context_free(h.c));
+
+    pthread_barrier_destroy(&barrier);
+}
+
+/*********************
+ * free_current_here *
+ *********************/
+
+/* freeing the calling thread's context leaves it on the default */
+
+void
+free_current_here()
+{
+    struct sr_context* c = sr_context_create();
+    sr_context_make_current(c);
+    TEST_ASSERT_EQUAL_PTR(c, sr_context_current());
+
+    TEST_ASSERT_EQUAL_INT(1, sr_context_free(c));
+    TEST_ASSERT_EQUAL_PTR(&g_default_ctx, sr_context_current());
+    TEST_ASSERT_EQUAL_INT(0, sr_context_free(&g_default_ctx));
+
+    sr_context_make_current(g_ctx);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                          derived data                             *
+ *                                                                   *
+ *********************************************************************/
+
+/*****************
+ * dirty_by_mode *
+ *****************/
+
+/* each matrix marks only what is derived from it, a draw clears all */
+
+void
+dirty_by_mode()
+{
+    TEST_ASSERT_EQUAL_HEX8(DIRTY_ALL, g_ctx->dirty);
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+    TEST_ASSERT_EQUAL_HEX8(0, g_ctx->dirty);
+
+    sr_translate(0.1, 0, 0);
+    TEST_ASSERT_EQUAL_HEX8(DIRTY_MVP | DIRTY_NORMAL, g_ctx->dirty);
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+
+    sr_matrix_mode(SR_VIEW_MATRIX);
+    sr_translate(0.1, 0, 0);
+    TEST_ASSERT_EQUAL_HEX8(DIRTY_MVP | DIRTY_CAM_POS, g_ctx->dirty);
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+
+    sr_matrix_mode(SR_PROJECTION_MATRIX);
+    sr_scale(1, 1, 1);
+    TEST_ASSERT_EQUAL_HEX8(DIRTY_MVP, g_ctx->dirty);
+}
+
+/*****************
+ * clean_no_work *
+ *****************/
+
+/* with nothing changed a draw leaves the derived matrices alone */
+
+void
+clean_no_work()
+{
+    sr_translate(0.1, 0, 0);
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+
+    struct mat4 marker = identity;
+    marker.e03 = 0.8;
+    g_ctx->mvp = marker;
+
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+    assert_mat(&marker, &g_ctx->mvp);
+}
+
+/*******************
+ * derived_matches *
+ *******************/
+
+/**
+ * after any mix of transforms the mvp, normal matrix and camera
+ * position match building them the long way, whichever shortcut
+ * each matrix's kind allowed
+ */
+
+void
+derived_matches()
+{
+    sr_matrix_mode(SR_PROJECTION_MATRIX);
+    sr_perspective(1.2, 1, 0.5, 50);
+    sr_matrix_mode(SR_VIEW_MATRIX);
+    sr_look_at(1, 2, 5,  0, 0, 0,  0, 1, 0);
+
+    for (int scaled = 0; scaled < 2; scaled++) {
+        sr_matrix_mode(SR_MODEL_MATRIX);
+        sr_load_identity();
+        sr_rotate_y(0.7);
+        sr_translate(0.3, -0.2, 0.1);
+        sr_rotate_z(0.4);
+        if (scaled)
+            sr_scale(2, 0.5, 3);
+
+        TEST_ASSERT_EQUAL_INT(scaled ? MAT_AFFINE : MAT_RIGID,
+                              g_ctx->kinds[SR_MODEL_MATRIX]);
+        sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+
+        struct mat4 mvp = g_ctx->proj;
+        matmul(&mvp, &g_ctx->view);
+        matmul(&mvp, &g_ctx->model);
+        assert_mat(&mvp, &g_ctx->mvp);
+
+        struct mat4 normal;
+        normal_matrix(&normal, &g_ctx->model, MAT_GENERAL);
+        assert_mat(&normal, &g_ctx->normal_transform);
+    }
+
+    TEST_ASSERT_EQUAL_INT(MAT_RIGID, g_ctx->kinds[SR_VIEW_MATRIX]);
+    TEST_ASSERT_EQUAL_INT(MAT_GENERAL, g_ctx->kinds[SR_PROJECTION_MATRIX]);
+
+    float eye[3] = {1, 2, 5};
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, eye[0], g_ctx->uniform.cam_pos[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, eye[1], g_ctx->uniform.cam_pos[1]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, eye[2], g_ctx->uniform.cam_pos[2]);
+}
+
+/*************
+ * instanced *
+ *************/
+
+/**
+ * each instance moves the triangle by its own matrix, through the
+ * fixed uniform or an sr_uniform bound in its place, and leaves the
+ * context's own matrices as they were
+ */
+
+void
+instanced()
+{
+    float models[2 * 16] = {
+        1, 0, 0, 0.8,  0, 1, 0, 0,    0, 0, 1, 0,  0, 0, 0, 1,
+        1, 0, 0, 0.8,  0, 1, 0, 0.8,  0, 0, 1, 0,  0, 0, 0, 1
+    };
+    struct mat4 identity = {
+        1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1
+    };
+
+    sr_renderl_instanced(g_indices, 3, SR_TRIANGLE_LIST, models, 2);
+
+    TEST_ASSERT_EQUAL_HEX32(1, g_colors[8 * 10 + 6]);
+    TEST_ASSERT_EQUAL_HEX32(1, g_colors[3 * 10 + 6]);
+    TEST_ASSERT_EQUAL_HEX32(0, g_colors[8 * 10 + 1]);
+    TEST_ASSERT_EQUAL_PTR(&g_ctx->model, g_ctx->uniform.model);
+    assert_mat(&identity, &g_ctx->model);
+
+    /* the hook fills the matrices of whichever uniform is bound */
+
+    clear();
+    struct mat4 model, normal_transform, mvp;
+    struct sr_uniform uniform = g_ctx->uniform;
+    uniform.model = &model;
+    uniform.normal_transform = &normal_transform;
+    uniform.mvp = &mvp;
+    sr_bind_uniform(&uniform);
+
+    sr_renderl_instanced(g_indices, 3, SR_TRIANGLE_LIST, models, 2);
+    sr_restore_uniform();
+
+    TEST_ASSERT_EQUAL_HEX32(1, g_colors[8 * 10 + 6]);
+    TEST_ASSERT_EQUAL_HEX32(1, g_colors[3 * 10 + 6]);
+    TEST_ASSERT_EQUAL_HEX32(0, g_colors[8 * 10 + 1]);
+    assert_mat(&identity, &g_ctx->model);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                          matrix stacks                            *
+ *                                                                   *
+ *********************************************************************/
+
+/******************
+ * pop_reuses_mvp *
+ ******************/
+
+/* popping back with nothing else changed restores the mvp as it was */
+
+void
+pop_reuses_mvp()
+{
+    sr_translate(0.2, 0.1, 0);
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+    struct mat4 model = g_ctx->model;
+    struct mat4 mvp = g_ctx->mvp;
+
+    TEST_ASSERT_EQUAL_INT(1, sr_push_matrix());
+    sr_rotate_z(0.5);
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+    TEST_ASSERT_EQUAL_INT(1, sr_pop_matrix());
+
+    TEST_ASSERT_EQUAL_HEX8(0, g_ctx->dirty);
+    assert_mat(&model, &g_ctx->model);
+    assert_mat(&mvp, &g_ctx->mvp);
+}
+
+/*************************
+ * pop_after_view_change *
+ *************************/
+
+/**
+ * a pushed mvp is stale once another mode's matrix changes, the pop
+ * must rebuild it from the current view rather than restore it
+ */
+
+void
+pop_after_view_change()
+{
+    sr_translate(0.2, 0.1, 0);
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+    TEST_ASSERT_EQUAL_INT(1, sr_push_matrix());
+    sr_translate(0.3, 0, 0);
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+
+    sr_matrix_mode(SR_VIEW_MATRIX);
+    sr_translate(0, -0.4, 0);
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+
+    sr_matrix_mode(SR_MODEL_MATRIX);
+    TEST_ASSERT_EQUAL_INT(1, sr_pop_matrix());
+    TEST_ASSERT_TRUE(g_ctx->dirty & DIRTY_MVP);
+
+    sr_renderl(g_indices, 3, SR_TRIANGLE_LIST);
+    struct mat4 mvp = g_ctx->proj;
+    matmul(&mvp, &g_ctx->view);
+    matmul(&mvp, &g_ctx->model);
+    assert_mat(&mvp, &g_ctx->mvp);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, -0.3, g_ctx->mvp.e13);
+}
+
+/********************
+ * stack_full_empty *
+ ********************/
+
+/* pushing past the depth and popping an empty stack both fail */
+
+void
+stack_full_empty()
+{
+    for (int i = 0; i < SR_MAX_STACK_DEPTH; i++) {
+        sr_translate(1, 0, 0);
+        TEST_ASSERT_EQUAL_INT(1, sr_push_matrix());
+    }
+    TEST_ASSERT_EQUAL_INT(0, sr_push_matrix());
+
+    /* each mode has its own stack */
+    sr_matrix_mode(SR_VIEW_MATRIX);
+    TEST_ASSERT_EQUAL_INT(0, sr_pop_matrix());
+    TEST_ASSERT_EQUAL_INT(1, sr_push_matrix());
+    TEST_ASSERT_EQUAL_INT(1, sr_pop_matrix());
+
+    sr_matrix_mode(SR_MODEL_MATRIX);
+    for (int i = SR_MAX_STACK_DEPTH; i > 0; i--) {
+        TEST_ASSERT_EQUAL_INT(1, sr_pop_matrix());
+        TEST_ASSERT_EQUAL_FLOAT(i, g_ctx->model.e03);
+    }
+    TEST_ASSERT_EQUAL_INT(0, sr_pop_matrix());
+    TEST_ASSERT_EQUAL_FLOAT(1, g_ctx->model.e03);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                              main                                 *
+ *                                                                   *
+ *********************************************************************/
+
+int
+main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(replay_matches_now);
+    RUN_TEST(submit_restores_uniform);
+    RUN_TEST(shared_states);
+    RUN_TEST(unbound_draw);
+    RUN_TEST(occlusion_on_submit);
+    RUN_TEST(bind_bad_samples);
+    RUN_TEST(two_threads);
+    RUN_TEST(free_current_elsewhere);
+    RUN_TEST(free_current_here);
+    RUN_TEST(dirty_by_mode);
+    RUN_TEST(clean_no_work);
+    RUN_TEST(derived_matches);
+    RUN_TEST(instanced);
+    RUN_TEST(pop_reuses_mvp);
+    RUN_TEST(pop_after_view_change);
+    RUN_TEST(stack_full_empty);
+    return UNITY_END();
+}
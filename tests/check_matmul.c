@@ -92,6 +92,96 @@ vmul()
     TEST_ASSERT_EQUAL_FLOAT_ARRAY(ans, out, 4);
 }
 
+/* transforms a strided batch, leaving the floats between vectors alone */
+
+void 
+vmul_n() 
+{
+    struct mat4 m = {
+        12, 3, 4, 19,
+        -10, 2, 48, 2,
+        8, 1, 0, 5,
+        11, 9, 10, 6
+    };
+
+    float vecs[15] = {
+        5, 2, 3, 1, -1,
+        0, 0, 0, 1, -2,
+        1, 0, 0, 0, -3
+    };
+
+    float ans[15] = {
+        97, 100, 47, 109, -1,
+        19, 2, 5, 6, -2,
+        12, -10, 8, 11, -3
+    };
+
+    vec4_matmul_n(vecs, &m, vecs, 3, 5);
+
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(ans, vecs, 15);
+}
+
+/* affine inverse agrees with the general one */
+
+void 
+inv_affine() 
+{
+    struct mat4 m = {
+        2, 1, 0, 3,
+        0, 3, 1, -2,
+        1, 0, 4, 5,
+        0, 0, 0, 1
+    };
+
+    struct mat4 ans = m;
+    TEST_ASSERT_EQUAL_INT(1, invert(&ans));
+    TEST_ASSERT_EQUAL_INT(1, invert_affine(&m));
+
+    float* expected = (float*)&ans;
+    float* actual = (float*)&m;
+    for (int i = 0; i < 16; i++)
+        TEST_ASSERT_FLOAT_WITHIN(1e-5, expected[i], actual[i]);
+}
+
+/* singular upper 3x3 is reported rather than inverted */
+
+void 
+inv_affine_singular() 
+{
+    struct mat4 m = {
+        1, 2, 3, 1,
+        2, 4, 6, 1,
+        0, 0, 1, 1,
+        0, 0, 0, 1
+    };
+
+    TEST_ASSERT_EQUAL_INT(0, invert_affine(&m));
+}
+
+/* rotation about z by a quarter turn then a translation */
+
+void 
+inv_rigid() 
+{
+    struct mat4 m = {
+        0, -1, 0, 4,
+        1, 0, 0, -2,
+        0, 0, 1, 7,
+        0, 0, 0, 1
+    };
+
+    struct mat4 ans = {
+        0, 1, 0, 2,
+        -1, 0, 0, 4,
+        0, 0, 1, -7,
+        0, 0, 0, 1
+    };
+
+    invert_rigid(&m);
+
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY((float*)&ans, (float*)&m, 16);
+}
+
 /*********************************************************************
  *                                                                   *
  *                              main                                 *
@@ -104,6 +194,10 @@ main()
     UNITY_BEGIN();
     RUN_TEST(mmul);
     RUN_TEST(vmul);
+    RUN_TEST(vmul_n);
+    RUN_TEST(inv_affine);
+    RUN_TEST(inv_affine_singular);
+    RUN_TEST(inv_rigid);
     return UNITY_END();
 }
 
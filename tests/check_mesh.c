@@ -0,0 +1,452 @@
+
+#include "unity.h"
+#include "mesh.c"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*********************************************************************
+ *                                                                   *
+ *                          unity helpers                            *
+ *                                                                   *
+ *********************************************************************/
+
+#define GRID 16     /* points per side of the test grid */
+
+int g_indices[6 * (GRID - 1) * (GRID - 1)];
+int g_n_indices;
+float g_pts[GRID * GRID * 3];      /* the grid flat at z = 0 */
+
+void
+setUp()
+{
+    g_n_indices = 0;
+
+    for (int y = 0; y < GRID - 1; y++) {
+        for (int x = 0; x < GRID - 1; x++) {
+            int p = y * GRID + x;
+            int quad[6] = {p, p + 1, p + GRID, p + 1, p + GRID + 1, p + GRID};
+            memcpy(g_indices + g_n_indices, quad, sizeof(quad));
+            g_n_indices += 6;
+        }
+    }
+
+    for (int i = 0; i < GRID * GRID; i++) {
+        g_pts[3 * i] = i % GRID;
+        g_pts[3 * i + 1] = i / GRID;
+        g_pts[3 * i + 2] = 0;
+    }
+}
+
+void
+tearDown()
+{
+}
+
+/* misses of a whole triangle list through the fifo cache */
+static float
+miss_ratio(int* indices, int n_indices, int n_pts)
+{
+    int* stamps = malloc(n_pts * sizeof(int));
+    memset(stamps, -1, n_pts * sizeof(int));
+
+    int clock = 0;
+    for (int i = 0; i < n_indices; i += 3)
+        fifo_misses(indices + i, stamps, &clock);
+
+    free(stamps);
+    return (float)clock / (n_indices / 3);
+}
+
+/* true if 'b' holds the triangles of 'a', each unrotated, in any order */
+static int
+same_tris(int* a, int* b, int n_indices)
+{
+    uint8_t* used = calloc(n_indices / 3, 1);
+    int found = 0;
+
+    for (int i = 0; i < n_indices; i += 3) {
+        for (int j = 0; j < n_indices; j += 3) {
+            if (!used[j / 3] && !memcmp(a + i, b + j, 3 * sizeof(int))) {
+                used[j / 3] = 1;
+                found++;
+                break;
+            }
+        }
+    }
+
+    free(used);
+    return found == n_indices / 3;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                           vertex cache                            *
+ *                                                                   *
+ *********************************************************************/
+
+/******************
+ * cache_shuffled *
+ ******************/
+
+/* a grid in scattered order comes back with far fewer misses */
+
+void
+cache_shuffled()
+{
+    int n_tris = g_n_indices / 3;
+    int shuffled[sizeof(g_indices) / sizeof(int)];
+
+    for (int i = 0; i < n_tris; i++) {
+        int t = (i * 97) % n_tris;      /* 97 is coprime to n_tris */
+        memcpy(shuffled + 3 * i, g_indices + 3 * t, 3 * sizeof(int));
+    }
+
+    int n_pts = GRID * GRID;
+    float before = miss_ratio(shuffled, g_n_indices, n_pts);
+
+    int dest[sizeof(g_indices) / sizeof(int)];
+    TEST_ASSERT_EQUAL_INT(1, sr_optimize_vertex_cache(dest, shuffled,
+                                                      g_n_indices, n_pts));
+
+    float after = miss_ratio(dest, g_n_indices, n_pts);
+
+    TEST_ASSERT_TRUE(same_tris(shuffled, dest, g_n_indices));
+    TEST_ASSERT_TRUE(after < 0.5f * before);
+    TEST_ASSERT_TRUE(after < 1.0f);
+}
+
+/******************
+ * cache_in_place *
+ ******************/
+
+/* 'dest' may be the input, degenerate triangles survive */
+
+void
+cache_in_place()
+{
+    int indices[9] = {0, 1, 2, 3, 3, 4, 2, 1, 3};
+    int copy[9];
+    memcpy(copy, indices, sizeof(indices));
+
+    TEST_ASSERT_EQUAL_INT(1, sr_optimize_vertex_cache(indices, indices,
+                                                      9, 5));
+    TEST_ASSERT_TRUE(same_tris(copy, indices, 9));
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             overdraw                              *
+ *                                                                   *
+ *********************************************************************/
+
+/******************
+ * overdraw_front *
+ ******************/
+
+/* of two facing quads the one further out along +z draws first */
+
+void
+overdraw_front()
+{
+    float pts[8 * 3] = {
+        0, 0, 0,    1, 0, 0,    1, 1, 0,    0, 1, 0,    /* back */
+        0, 0, 2,    1, 0, 2,    1, 1, 2,    0, 1, 2     /* front */
+    };
+
+    int indices[12] = {
+        0, 1, 2,    0, 2, 3,
+        4, 5, 6,    4, 6, 7
+    };
+
+    int dest[12];
+    TEST_ASSERT_EQUAL_INT(1, sr_optimize_overdraw(dest, indices, 12, pts,
+                                                  8, 3, 1.05f));
+
+    int ans[12] = {
+        4, 5, 6,    4, 6, 7,
+        0, 1, 2,    0, 2, 3
+    };
+    TEST_ASSERT_EQUAL_INT_ARRAY(ans, dest, 12);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                           vertex fetch                            *
+ *                                                                   *
+ *********************************************************************/
+
+/***************
+ * fetch_remap *
+ ***************/
+
+/* points follow first use, unused ones drop off the end */
+
+void
+fetch_remap()
+{
+    float pts[5 * 2] = {
+        0, 0,   1, 1,   2, 2,   3, 3,   4, 4
+    };
+    int indices[6] = {3, 1, 4, 1, 3, 0};
+
+    int n_pts = sr_optimize_vertex_fetch(pts, 5, 2, indices, 6);
+    TEST_ASSERT_EQUAL_INT(4, n_pts);
+
+    int ans_indices[6] = {0, 1, 2, 1, 0, 3};
+    float ans_pts[4 * 2] = {3, 3,   1, 1,   4, 4,   0, 0};
+
+    TEST_ASSERT_EQUAL_INT_ARRAY(ans_indices, indices, 6);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(ans_pts, pts, 8);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                          simplification                           *
+ *                                                                   *
+ *********************************************************************/
+
+/******************
+ * simplify_plane *
+ ******************/
+
+/**
+ * a flat grid comes down to a handful of triangles without moving, 
+ * still covering the whole square and facing the same way
+ */
+
+void
+simplify_plane()
+{
+    int dest[sizeof(g_indices) / sizeof(int)];
+    float error = -1;
+
+    int n = sr_simplify(dest, g_indices, g_n_indices, g_pts, 
+                        GRID * GRID, 3, 12, &error);
+    TEST_ASSERT_TRUE(n > 0 && n <= 12);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 0, error);
+
+    float area = 0;
+    for (int i = 0; i < n; i += 3) {
+        float normal[3];
+        tri_normal(normal, g_pts + 3 * dest[i], g_pts + 3 * dest[i + 1], 
+                   g_pts + 3 * dest[i + 2]);
+        TEST_ASSERT_TRUE(normal[2] > 0);
+        area += normal[2] / 2;
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1e-2, (GRID - 1) * (GRID - 1), area);
+}
+
+/******************
+ * simplify_bumpy *
+ ******************/
+
+/* the fewer triangles are asked for, the further the surface moves */
+
+void
+simplify_bumpy()
+{
+    for (int i = 0; i < GRID * GRID; i++)
+        g_pts[3 * i + 2] = sinf(g_pts[3 * i]) * cosf(g_pts[3 * i + 1]);
+
+    int dest[sizeof(g_indices) / sizeof(int)];
+    float fine;
+    float coarse;
+
+    int n_fine = sr_simplify(dest, g_indices, g_n_indices, g_pts, 
+                             GRID * GRID, 3, g_n_indices / 2, &fine);
+    int n_coarse = sr_simplify(dest, g_indices, g_n_indices, g_pts, 
+                               GRID * GRID, 3, g_n_indices / 8, &coarse);
+
+    TEST_ASSERT_TRUE(n_fine <= g_n_indices / 2);
+    TEST_ASSERT_TRUE(n_coarse <= g_n_indices / 8);
+    TEST_ASSERT_TRUE(fine > 0);
+    TEST_ASSERT_TRUE(coarse > fine);
+    TEST_ASSERT_TRUE(coarse < 2);
+}
+
+/*****************
+ * simplify_seam *
+ *****************/
+
+/**
+ * the grid's left and right halves get points of their own along 
+ * the middle column, as a texture seam would, simplifying keeps 
+ * every triangle on its own side's points
+ */
+
+void
+simplify_seam()
+{
+    int mid = GRID / 2;
+    float pts[(GRID * GRID + GRID) * 3];
+    memcpy(pts, g_pts, sizeof(g_pts));
+
+    for (int y = 0; y < GRID; y++)      /* right side copies of the seam */
+        memcpy(pts + 3 * (GRID * GRID + y), g_pts + 3 * (y * GRID + mid), 
+               3 * sizeof(float));
+
+    int indices[sizeof(g_indices) / sizeof(int)];
+    for (int i = 0; i < g_n_indices; i += 3) {
+        int* tri = g_indices + i;
+        int right = tri[0] % GRID + tri[1] % GRID + tri[2] % GRID > 3 * mid;
+        for (int k = 0; k < 3; k++) {
+            int v = tri[k];
+            indices[i + k] = right && v % GRID == mid ? 
+                             GRID * GRID + v / GRID : v;
+        }
+    }
+
+    int n = sr_simplify(indices, indices, g_n_indices, pts, 
+                        GRID * GRID + GRID, 3, 24, 0);
+    TEST_ASSERT_TRUE(n > 0 && n < g_n_indices / 4);
+
+    for (int i = 0; i < n; i += 3) {
+        int left = 0;
+        int right = 0;
+        for (int k = 0; k < 3; k++) {
+            int v = indices[i + k];
+            left |= v < GRID * GRID && v % GRID < mid;
+            right |= v >= GRID * GRID || v % GRID > mid;
+        }
+        TEST_ASSERT_FALSE(left && right);
+    }
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             meshlets                              *
+ *                                                                   *
+ *********************************************************************/
+
+/******************
+ * meshlet_limits *
+ ******************/
+
+/**
+ * a large grid splits into meshlets within the limits that together 
+ * hold every triangle, points carry their source index to check it
+ */
+
+void
+meshlet_limits()
+{
+    int grid = 40;
+    int n_pts = grid * grid;
+    int n_indices = 6 * (grid - 1) * (grid - 1);
+
+    float* pts = malloc(n_pts * 4 * sizeof(float));
+    int* indices = malloc(n_indices * sizeof(int));
+
+    for (int i = 0; i < n_pts; i++) {
+        float pt[4] = {i % grid, i / grid, 0, i};
+        memcpy(pts + 4 * i, pt, sizeof(pt));
+    }
+
+    int n = 0;
+    for (int y = 0; y < grid - 1; y++) {
+        for (int x = 0; x < grid - 1; x++) {
+            int p = y * grid + x;
+            int quad[6] = {p, p + 1, p + grid, p + 1, p + grid + 1, p + grid};
+            memcpy(indices + n, quad, sizeof(quad));
+            n += 6;
+        }
+    }
+
+    struct sr_meshlets* ml = sr_build_meshlets(pts, n_pts, 4, 
+                                               indices, n_indices);
+    TEST_ASSERT_NOT_NULL(ml);
+    TEST_ASSERT_EQUAL_INT(n_indices, ml->n_indices);
+    TEST_ASSERT_TRUE(ml->n_meshlets >= n_indices / 3 / SR_MESHLET_MAX_TRIS);
+
+    int* rebuilt = malloc(n_indices * sizeof(int));
+    int covered = 0;
+
+    for (int i = 0; i < ml->n_meshlets; i++) {
+        struct sr_meshlet* m = ml->meshlets + i;
+        TEST_ASSERT_EQUAL_INT(covered, m->first_index);
+        TEST_ASSERT_TRUE(m->n_indices <= 3 * SR_MESHLET_MAX_TRIS);
+
+        int n_local = (i + 1 < ml->n_meshlets ? 
+                       ml->meshlets[i + 1].base_vertex : ml->n_pts) - 
+                      m->base_vertex;
+        TEST_ASSERT_TRUE(n_local <= SR_MESHLET_MAX_PTS);
+
+        for (int j = 0; j < m->n_indices; j++) {
+            int local = ml->indices[m->first_index + j];
+            TEST_ASSERT_TRUE(local >= 0 && local < n_local);
+            rebuilt[covered + j] = 
+                ml->pts[(m->base_vertex + local) * 4 + 3];
+        }
+        covered += m->n_indices;
+
+        /* every point sits in the sphere, a flat patch faces +z */
+
+        for (int j = 0; j < n_local; j++) {
+            float* p = ml->pts + (m->base_vertex + j) * 4;
+            float dx = p[0] - m->center[0];
+            float dy = p[1] - m->center[1];
+            float dz = p[2] - m->center[2];
+            TEST_ASSERT_TRUE(sqrtf(dx * dx + dy * dy + dz * dz) <= 
+                             m->radius + 1e-4f);
+        }
+
+        TEST_ASSERT_FLOAT_WITHIN(1e-5, 1, m->cone_axis[2]);
+        TEST_ASSERT_FLOAT_WITHIN(1e-3, 0, m->cone_cutoff);
+    }
+
+    TEST_ASSERT_TRUE(same_tris(indices, rebuilt, n_indices));
+
+    free(rebuilt);
+    sr_meshlets_free(ml);
+    free(pts);
+    free(indices);
+}
+
+/****************
+ * meshlet_cone *
+ ****************/
+
+/* a closed tetrahedron faces every way, so its cone never culls */
+
+void
+meshlet_cone()
+{
+    float pts[4 * 3] = {
+        0, 0, 0,    1, 0, 0,    0, 1, 0,    0, 0, 1
+    };
+    int indices[12] = {
+        0, 2, 1,    0, 1, 3,    0, 3, 2,    1, 2, 3
+    };
+
+    struct sr_meshlets* ml = sr_build_meshlets(pts, 4, 3, indices, 12);
+    TEST_ASSERT_NOT_NULL(ml);
+    TEST_ASSERT_EQUAL_INT(1, ml->n_meshlets);
+    TEST_ASSERT_EQUAL_INT(4, ml->n_pts);
+    TEST_ASSERT_EQUAL_FLOAT(1, ml->meshlets[0].cone_cutoff);
+
+    sr_meshlets_free(ml);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                              main                                 *
+ *                                                                   *
+ *********************************************************************/
+
+int
+main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(cache_shuffled);
+    RUN_TEST(cache_in_place);
+    RUN_TEST(overdraw_front);
+    RUN_TEST(fetch_remap);
+    RUN_TEST(simplify_plane);
+    RUN_TEST(simplify_bumpy);
+    RUN_TEST(simplify_seam);
+    RUN_TEST(meshlet_limits);
+    RUN_TEST(meshlet_cone);
+    return UNITY_END();
+}
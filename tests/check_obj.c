@@ -0,0 +1,484 @@
+
+#include "unity.h"
+#include "obj.c"
+#include "mesh.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*********************************************************************
+ *                                                                   *
+ *                          unity helpers                            *
+ *                                                                   *
+ *********************************************************************/
+
+struct sr_obj g_obj;
+
+void
+setUp()
+{
+    memset(&g_obj, 0, sizeof(g_obj));
+}
+
+void
+tearDown()
+{
+    free(g_obj.pts);
+    free(g_obj.indices);
+}
+
+/* parses a string as an obj split over 'n' chunks */
+static int
+parse_str(const char* src, int n)
+{
+    return parse_mapped(src, strlen(src), n, &g_obj);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             scanning                              *
+ *                                                                   *
+ *********************************************************************/
+
+/**********
+ * floats *
+ **********/
+
+/* decimal, signed, exponent and long mantissa forms */
+
+void
+floats()
+{
+    const char* src = " 1 -2.5 +0.125 3e2 -1.5E-3 .5 "
+                      "0.30000000000000000000001 123456789.0\n";
+    const char* p = src;
+    const char* end = src + strlen(src);
+
+    float ans[8] = {1, -2.5, 0.125, 300, -0.0015, 0.5, 0.3, 123456789};
+
+    for (int i = 0; i < 8; i++)
+        TEST_ASSERT_EQUAL_FLOAT(ans[i], parse_float(&p, end));
+
+    TEST_ASSERT_EQUAL_CHAR('\n', *p);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                              meshes                               *
+ *                                                                   *
+ *********************************************************************/
+
+/**************
+ * shared_pts *
+ **************/
+
+/* a quad fans into two triangles sharing the corners they repeat */
+
+void
+shared_pts()
+{
+    const char* src =
+        "# quad\n"
+        "v 0 0 0\n"
+        "v 1 0 0\n"
+        "v 1 1 0\n"
+        "v 0 1 0\n"
+        "vt 0 0\n"
+        "vt 1 1\n"
+        "vn 0 0 1\n"
+        "f 1/1/1 2/1/1 3/2/1 4/2/1\n";
+
+    TEST_ASSERT_EQUAL_INT(1, parse_str(src, 1));
+    TEST_ASSERT_EQUAL_INT(8, g_obj.n_attr);
+    TEST_ASSERT_EQUAL_INT(4, g_obj.n_pts);
+    TEST_ASSERT_EQUAL_INT(6, g_obj.n_indices);
+
+    int indices[6] = {0, 1, 2, 0, 2, 3};
+    TEST_ASSERT_EQUAL_INT_ARRAY(indices, g_obj.indices, 6);
+
+    float pt[8] = {1, 1, 0, 1, 1, 0, 0, 1};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(pt, g_obj.pts + 2 * 8, 8);
+
+    float bounds[6] = {0, 0, 0, 1, 1, 0};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(bounds, g_obj.bounds, 6);
+}
+
+/********************
+ * relative_indices *
+ ********************/
+
+/* negative indices count back from the last record, gaps stay zero */
+
+void
+relative_indices()
+{
+    const char* src =
+        "v 0 0 0\r\n"
+        "v 1 0 0\r\n"
+        "v 0 1 0\r\n"
+        "vn 0 0 -1\r\n"
+        "f -3//-1 -2//-1 -1//-1\r\n"
+        "f 1 2 3\r\n";
+
+    TEST_ASSERT_EQUAL_INT(1, parse_str(src, 1));
+    TEST_ASSERT_EQUAL_INT(6, g_obj.n_pts);
+
+    float pt[8] = {1, 0, 0, 0, 0, 0, 0, -1};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(pt, g_obj.pts + 1 * 8, 8);
+
+    float bare[8] = {0, 1, 0, 0, 0, 0, 0, 0};
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(bare, g_obj.pts + 5 * 8, 8);
+}
+
+/**********
+ * chunks *
+ **********/
+
+/* splitting the file between threads changes nothing */
+
+void
+chunks()
+{
+    char src[4096] = "";
+    for (int i = 0; i < 40; i++) {
+        char line[64];
+        sprintf(line, "v %d %d 0\nv %d %d 1\n", i, -i, i, i);
+        strcat(src, line);
+        if (i > 0) {
+            sprintf(line, "f %d %d -1\n", 2 * i - 1, 2 * i);
+            strcat(src, line);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT(1, parse_str(src, 1));
+    struct sr_obj one = g_obj;
+    memset(&g_obj, 0, sizeof(g_obj));
+
+    TEST_ASSERT_EQUAL_INT(1, parse_str(src, 7));
+    TEST_ASSERT_EQUAL_INT(one.n_pts, g_obj.n_pts);
+    TEST_ASSERT_EQUAL_INT(39 * 3, g_obj.n_indices);
+    TEST_ASSERT_EQUAL_INT_ARRAY(one.indices, g_obj.indices, 39 * 3);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(one.pts, g_obj.pts, 8 * one.n_pts);
+
+    free(one.pts);
+    free(one.indices);
+}
+
+/****************
+ * face_comment *
+ ****************/
+
+/* a comment after a face's corners isn't read as more of them */
+
+void
+face_comment()
+{
+    const char* src =
+        "v 0 0 0\n"
+        "v 1 0 0\n"
+        "v 0 1 0 # last\n"
+        "f 1 2 3 # tri\n";
+
+    TEST_ASSERT_EQUAL_INT(1, parse_str(src, 1));
+    TEST_ASSERT_EQUAL_INT(3, g_obj.n_pts);
+    TEST_ASSERT_EQUAL_INT(3, g_obj.n_indices);
+
+    int indices[3] = {0, 1, 2};
+    TEST_ASSERT_EQUAL_INT_ARRAY(indices, g_obj.indices, 3);
+}
+
+/*************
+ * bad_index *
+ *************/
+
+/* a face past the end of the positions fails the load */
+
+void
+bad_index()
+{
+    const char* src =
+        "v 0 0 0\n"
+        "v 1 0 0\n"
+        "f 1 2 3\n";
+
+    TEST_ASSERT_EQUAL_INT(0, parse_str(src, 1));
+}
+
+/********
+ * lods *
+ ********/
+
+/**
+ * a bumpy grid gets coarser levels after the full mesh, each 
+ * smaller and further off than the last, in one index buffer
+ */
+
+void
+lods()
+{
+    char* src = malloc(1 << 16);
+    char* p = src;
+
+    for (int y = 0; y < 20; y++)
+        for (int x = 0; x < 20; x++)
+            p += sprintf(p, "v %d %d %f\n", x, y, sinf(x) * cosf(y));
+    for (int y = 0; y < 19; y++) {
+        for (int x = 0; x < 19; x++) {
+            int v = y * 20 + x + 1;
+            p += sprintf(p, "f %d %d %d %d\n", v, v + 1, v + 21, v + 20);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT(1, parse_str(src, 1));
+    free(src);
+
+    TEST_ASSERT_TRUE(g_obj.n_lods > 1);
+    TEST_ASSERT_EQUAL_INT(0, g_obj.lods[0].first_index);
+    TEST_ASSERT_EQUAL_INT(g_obj.n_indices, g_obj.lods[0].n_indices);
+    TEST_ASSERT_EQUAL_FLOAT(0, g_obj.lods[0].error);
+
+    for (int i = 1; i < g_obj.n_lods; i++) {
+        struct sr_lod* prev = g_obj.lods + i - 1;
+        struct sr_lod* lod = g_obj.lods + i;
+
+        TEST_ASSERT_EQUAL_INT(prev->first_index + prev->n_indices, 
+                              lod->first_index);
+        TEST_ASSERT_TRUE(lod->n_indices <= prev->n_indices / 4);
+        TEST_ASSERT_TRUE(lod->error > prev->error);
+
+        for (int j = 0; j < lod->n_indices; j++) {
+            int v = g_obj.indices[lod->first_index + j];
+            TEST_ASSERT_TRUE(v >= 0 && v < g_obj.n_pts);
+        }
+    }
+}
+
+/********************
+ * lods_with_stalls *
+ ********************/
+
+/**
+ * a grid beside many separate tetrahedra, whose faces share no 
+ * points, simplifies only in part, so a level can stall at most of 
+ * the size of the last and still has to fit
+ */
+
+void
+lods_with_stalls()
+{
+    char* src = malloc(1 << 21);
+    char* p = src;
+
+    for (int y = 0; y < 60; y++)
+        for (int x = 0; x < 60; x++)
+            p += sprintf(p, "v %d %d 0\n", x, y);
+    for (int y = 0; y < 59; y++) {
+        for (int x = 0; x < 59; x++) {
+            int v = y * 60 + x + 1;
+            p += sprintf(p, "f %d %d %d %d\n", v, v + 1, v + 61, v + 60);
+        }
+    }
+
+    /* each face its own three points */
+
+    float tet[4][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    int faces[4][3] = {{0, 2, 1}, {0, 1, 3}, {0, 3, 2}, {1, 2, 3}};
+    int n_pts = 60 * 60;
+
+    for (int t = 0; t < 2400; t++) {
+        float ox = 100 + 2 * (t % 50);
+        float oy = 2 * (t / 50);
+        for (int f = 0; f < 4; f++) {
+            for (int k = 0; k < 3; k++) {
+                float* c = tet[faces[f][k]];
+                p += sprintf(p, "v %g %g %g\n", 
+                             ox + c[0], oy + c[1], c[2]);
+            }
+            p += sprintf(p, "f %d %d %d\n", 
+                         n_pts + 1, n_pts + 2, n_pts + 3);
+            n_pts += 3;
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT(1, parse_str(src, 1));
+    free(src);
+
+    TEST_ASSERT_TRUE(g_obj.n_lods > 1);
+
+    for (int i = 1; i < g_obj.n_lods; i++) {
+        struct sr_lod* prev = g_obj.lods + i - 1;
+        struct sr_lod* lod = g_obj.lods + i;
+
+        TEST_ASSERT_EQUAL_INT(prev->first_index + prev->n_indices, 
+                              lod->first_index);
+        TEST_ASSERT_TRUE(lod->n_indices <= prev->n_indices * 3 / 4);
+
+        for (int j = 0; j < lod->n_indices; j++) {
+            int v = g_obj.indices[lod->first_index + j];
+            TEST_ASSERT_TRUE(v >= 0 && v < g_obj.n_pts);
+        }
+    }
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                              cache                                *
+ *                                                                   *
+ *********************************************************************/
+
+/**************
+ * write_file *
+ **************/
+
+static void
+write_file(char* path, const char* src)
+{
+    FILE* f = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    fputs(src, f);
+    fclose(f);
+}
+
+/****************
+ * cache_reload *
+ ****************/
+
+/* the second load maps the cache the first wrote, an edit drops it */
+
+void
+cache_reload()
+{
+    char path[] = "/tmp/check_obj_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    write_file(path, "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0.5 0.5\n"
+                     "f 1/1 2/1 3/1\n");
+
+    struct sr_obj* parsed = sr_load_obj(path);
+    TEST_ASSERT_NOT_NULL(parsed);
+    TEST_ASSERT_NULL(parsed->map);
+
+    struct sr_obj* cached = sr_load_obj(path);
+    TEST_ASSERT_NOT_NULL(cached);
+    TEST_ASSERT_NOT_NULL(cached->map);
+    TEST_ASSERT_EQUAL_INT(0, (uintptr_t)cached->pts % 16);
+    TEST_ASSERT_EQUAL_INT(parsed->n_pts, cached->n_pts);
+    TEST_ASSERT_EQUAL_INT(parsed->n_attr, cached->n_attr);
+    TEST_ASSERT_EQUAL_INT(parsed->n_indices, cached->n_indices);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(parsed->pts, cached->pts, 
+                                  parsed->n_pts * parsed->n_attr);
+    TEST_ASSERT_EQUAL_INT_ARRAY(parsed->indices, cached->indices, 
+                                parsed->n_indices);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(parsed->bounds, cached->bounds, 6);
+    TEST_ASSERT_EQUAL_INT(parsed->n_lods, cached->n_lods);
+    TEST_ASSERT_EQUAL_MEMORY(parsed->lods, cached->lods, 
+                             sizeof(parsed->lods));
+
+    cached->pts[0] = 7;     /* private to this load */
+    sr_obj_free(cached);
+
+    cached = sr_load_obj(path);
+    TEST_ASSERT_EQUAL_FLOAT(0, cached->pts[0]);
+    sr_obj_free(cached);
+
+    /* a different source misses the cache */
+    write_file(path, "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n"
+                     "f 1 2 3 4\n");
+
+    struct sr_obj* edited = sr_load_obj(path);
+    TEST_ASSERT_NOT_NULL(edited);
+    TEST_ASSERT_NULL(edited->map);
+    TEST_ASSERT_EQUAL_INT(6, edited->n_indices);
+
+    sr_obj_free(parsed);
+    sr_obj_free(edited);
+
+    char* cache = cache_path(path);
+    unlink(cache);
+    free(cache);
+    unlink(path);
+}
+
+/****************
+ * cache_damage *
+ ****************/
+
+/**
+ * a cache of another point layout or with an index past the points
+ * is ignored and the source parsed again, rewriting the cache
+ */
+
+void
+cache_damage()
+{
+    char path[] = "/tmp/check_obj_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    write_file(path, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n");
+    sr_obj_free(sr_load_obj(path));
+
+    char* cache = cache_path(path);
+    struct cache_header h;
+
+    for (int damage = 0; damage < 2; damage++) {
+        FILE* f = fopen(cache, "r+b");
+        TEST_ASSERT_NOT_NULL(f);
+        TEST_ASSERT_EQUAL_INT(1, fread(&h, sizeof(h), 1, f));
+
+        if (damage == 0) {
+            h.n_attr = OBJ_N_ATTR - 3;
+        } else {
+            int past = h.n_pts;
+            fseek(f, h.indices_off + sizeof(int), SEEK_SET);
+            fwrite(&past, sizeof(int), 1, f);
+        }
+        fseek(f, 0, SEEK_SET);
+        fwrite(&h, sizeof(h), 1, f);
+        fclose(f);
+
+        struct sr_obj* obj = sr_load_obj(path);
+        TEST_ASSERT_NOT_NULL(obj);
+        TEST_ASSERT_NULL(obj->map);
+        TEST_ASSERT_EQUAL_INT(OBJ_N_ATTR, obj->n_attr);
+        int ans[3] = {0, 1, 2};
+        TEST_ASSERT_EQUAL_INT_ARRAY(ans, obj->indices, 3);
+        sr_obj_free(obj);
+
+        /* the rewritten cache is good again */
+        obj = sr_load_obj(path);
+        TEST_ASSERT_NOT_NULL(obj->map);
+        sr_obj_free(obj);
+    }
+
+    unlink(cache);
+    free(cache);
+    unlink(path);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                              main                                 *
+ *                                                                   *
+ *********************************************************************/
+
+int
+main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(floats);
+    RUN_TEST(shared_pts);
+    RUN_TEST(relative_indices);
+    RUN_TEST(chunks);
+    RUN_TEST(face_comment);
+    RUN_TEST(bad_index);
+    RUN_TEST(lods);
+    RUN_TEST(lods_with_stalls);
+    RUN_TEST(cache_reload);
+    RUN_TEST(cache_damage);
+    return UNITY_END();
+}
@@ -0,0 +1,316 @@
+
+#include "unity.h"
+#include "occl.c"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*********************************************************************
+ *                                                                   *
+ *                          unity helpers                            *
+ *                                                                   *
+ *********************************************************************/
+
+/* looks down -z, near 1 far 100, 90 degrees */
+struct mat4 g_proj = {
+    1, 0, 0, 0,
+    0, 1, 0, 0,
+    0, 0, -101.0f / 99, -200.0f / 99,
+    0, 0, -1, 0
+};
+
+struct sr_occlusion* g_occ;
+
+void
+setUp()
+{
+    g_occ = sr_occlusion_create(16, 16);
+}
+
+void
+tearDown()
+{
+    sr_occlusion_free(g_occ);
+}
+
+/* draws the quad from x0 to x1 and y0 to y1 at depth z as an occluder */
+static void
+quad(float x0, float x1, float y0, float y1, float z)
+{
+    float pts[4 * 3] = {
+        x0, y0, z,  x1, y0, z,  x1, y1, z,  x0, y1, z
+    };
+    int indices[6] = {0, 1, 2, 0, 2, 3};
+
+    occlusion_draw(g_occ, &g_proj, pts, 4, 3, indices, 6);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             raster                                *
+ *                                                                   *
+ *********************************************************************/
+
+/******************
+ * depth_only_tri *
+ ******************/
+
+/**
+ * either winding fills, texels inside the triangle take its depth,
+ * those it only touches the farthest of any touching, and those
+ * reaching past an open edge are marked
+ */
+
+void
+depth_only_tri()
+{
+    float depths[4 * 4];
+    float seams[4 * 4];
+    uint8_t opens[4 * 4];
+    for (int i = 0; i < 16; i++) {
+        depths[i] = INFINITY;
+        seams[i] = 0;
+    }
+    memset(opens, 0, sizeof(opens));
+
+    /* screen space, the last value is 1 / w, only the long edge open */
+
+    float v0[4] = {0, 0, 0, 1.0f / 2};
+    float v1[4] = {0, 3.9, 0, 1.0f / 2};
+    float v2[4] = {3.9, 0, 0, 1.0f / 2};
+    draw_tr_depth(depths, seams, opens, 4, 4, v0, v1, v2, 1);
+
+    float v3[4] = {0, 0, 0, 1.0f / 8};
+    float v4[4] = {3.9, 0, 0, 1.0f / 8};
+    float v5[4] = {0, 3.9, 0, 1.0f / 8};
+    draw_tr_depth(depths, seams, opens, 4, 4, v3, v4, v5, 1);
+
+    float inf = INFINITY;
+    float ans[16] = {
+        2, 2, inf, inf,
+        2, inf, inf, inf,
+        inf, inf, inf, inf,
+        inf, inf, inf, inf
+    };
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(ans, depths, 16);
+
+    float seam_ans[16] = {
+        8, 8, 8, 8,
+        8, 8, 8, 0,
+        8, 8, 0, 0,
+        8, 0, 0, 0
+    };
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(seam_ans, seams, 16);
+
+    uint8_t open_ans[16] = {
+        0, 0, 1, 1,
+        0, 1, 1, 0,
+        1, 1, 0, 0,
+        1, 0, 0, 0
+    };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(open_ans, opens, 16);
+}
+
+/*****************
+ * sloped_depths *
+ *****************/
+
+/* a texel keeps the farthest depth over it, not that at its center */
+
+void
+sloped_depths()
+{
+    float depths[4 * 4];
+    float seams[4 * 4];
+    uint8_t opens[4 * 4];
+    for (int i = 0; i < 16; i++) {
+        depths[i] = INFINITY;
+        seams[i] = 0;
+    }
+    memset(opens, 0, sizeof(opens));
+
+    /* 1 / w falls from 1 / 2 by 1 / 32 a texel to the right */
+
+    float v0[4] = {0, 0, 0, 1.0f / 2};
+    float v1[4] = {8, 0, 0, 1.0f / 4};
+    float v2[4] = {0, 8, 0, 1.0f / 2};
+    draw_tr_depth(depths, seams, opens, 4, 4, v0, v1, v2, 7);
+
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1 / (0.5f - 2 / 32.0f), depths[1]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1 / (0.5f - 4 / 32.0f), depths[3]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1 / (0.5f - 4 / 32.0f), seams[3]);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             testing                               *
+ *                                                                   *
+ *********************************************************************/
+
+/**************
+ * wall_hides *
+ **************/
+
+/* a wall across the view hides what's behind it, not what's before */
+
+void
+wall_hides()
+{
+    quad(-20, 20, -20, 20, -5);
+
+    float behind[6] = {-1, -1, -20, 1, 1, -15};
+    float before[6] = {-1, -1, -4, 1, 1, -3};
+    float through[6] = {-1, -1, -6, 1, 1, -4};
+
+    TEST_ASSERT_EQUAL_INT(1, occlusion_test(g_occ, &g_proj, behind));
+    TEST_ASSERT_EQUAL_INT(0, occlusion_test(g_occ, &g_proj, before));
+    TEST_ASSERT_EQUAL_INT(0, occlusion_test(g_occ, &g_proj, through));
+}
+
+/****************
+ * partial_wall *
+ ****************/
+
+/* only boxes wholly behind the covered part are hidden */
+
+void
+partial_wall()
+{
+    quad(-20, 0, -20, 20, -5);
+
+    float left[6] = {-8, -1, -20, -2, 1, -15};
+    float right[6] = {2, -1, -20, 8, 1, -15};
+    float across[6] = {-2, -1, -20, 2, 1, -15};
+
+    TEST_ASSERT_EQUAL_INT(1, occlusion_test(g_occ, &g_proj, left));
+    TEST_ASSERT_EQUAL_INT(0, occlusion_test(g_occ, &g_proj, right));
+    TEST_ASSERT_EQUAL_INT(0, occlusion_test(g_occ, &g_proj, across));
+}
+
+/******************
+ * silhouette_gap *
+ ******************/
+
+/**
+ * a box in the part of a texel the wall's edge leaves open is seen,
+ * though the wall covers the texel's center
+ */
+
+void
+silhouette_gap()
+{
+    /* the edge falls at 8.6 on screen, past the center of texel 8 */
+    quad(-20, 0.375f, -20, 20, -5);
+
+    float gap[6] = {1.76f, -1, -20, 1.78f, 1, -15};
+    float covered[6] = {-1.78f, -1, -20, -1.76f, 1, -15};
+
+    TEST_ASSERT_EQUAL_INT(0, occlusion_test(g_occ, &g_proj, gap));
+    TEST_ASSERT_EQUAL_INT(1, occlusion_test(g_occ, &g_proj, covered));
+}
+
+/***************
+ * sloped_wall *
+ ***************/
+
+/**
+ * a box in front of a slanted wall is seen, though it lies behind
+ * the wall's depth at the centers of the texels it falls in
+ */
+
+void
+sloped_wall()
+{
+    /* eye depth 22 / (1 - 0.9 x / w), 23.3 to 24.8 across texel 8 */
+    float pts[4 * 3] = {
+        -20, -20, -4,  20, -20, -40,  20, 20, -40,  -20, 20, -4
+    };
+    int indices[6] = {0, 1, 2, 0, 2, 3};
+    occlusion_draw(g_occ, &g_proj, pts, 4, 3, indices, 6);
+
+    float before[6] = {2.1f, -1, -30, 2.4f, 1, -24};
+    float behind[6] = {2.1f, -1, -40, 2.4f, 1, -30};
+
+    TEST_ASSERT_EQUAL_INT(0, occlusion_test(g_occ, &g_proj, before));
+    TEST_ASSERT_EQUAL_INT(1, occlusion_test(g_occ, &g_proj, behind));
+}
+
+/********
+ * slot *
+ ********/
+
+/**
+ * a box seen through a slot narrower than a texel, between two
+ * panels drawn as one occluder, is not hidden, while one behind the
+ * diagonal joining a panel's two triangles is
+ */
+
+void
+slot()
+{
+    /* the slot runs from 8.2 to 8.4 on screen, inside texel 8 */
+
+    float pts[8 * 3] = {
+        -2, -2, -5,  0.125f, -2, -5,  0.125f, 2, -5,  -2, 2, -5,
+        0.25f, -2, -5,  2, -2, -5,  2, 2, -5,  0.25f, 2, -5
+    };
+    int indices[12] = {0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7};
+    occlusion_draw(g_occ, &g_proj, pts, 8, 3, indices, 12);
+
+    float through[6] = {0.55f, -1, -20, 0.7f, 1, -15};
+    float behind[6] = {-4, -3, -20, -1, 3, -15};
+
+    TEST_ASSERT_EQUAL_INT(0, occlusion_test(g_occ, &g_proj, through));
+    TEST_ASSERT_EQUAL_INT(1, occlusion_test(g_occ, &g_proj, behind));
+}
+
+/**************
+ * near_plane *
+ **************/
+
+/**
+ * an occluder through the near plane is clipped rather than lost,
+ * a box around the eye is never hidden
+ */
+
+void
+near_plane()
+{
+    quad(-20, 20, -20, 20, -5);
+    float floor_pts[4 * 3] = {
+        -50, -2, 10,  50, -2, 10,  50, -2, -50,  -50, -2, -50
+    };
+    int indices[6] = {0, 1, 2, 0, 2, 3};
+    occlusion_draw(g_occ, &g_proj, floor_pts, 4, 3, indices, 6);
+
+    float behind[6] = {-1, -1, -20, 1, 1, -15};
+    float eye[6] = {-1, -1, -1, 1, 1, 1};
+
+    TEST_ASSERT_EQUAL_INT(1, occlusion_test(g_occ, &g_proj, behind));
+    TEST_ASSERT_EQUAL_INT(0, occlusion_test(g_occ, &g_proj, eye));
+
+    /* the bottom row of texels sees the floor close up */
+    TEST_ASSERT_TRUE(g_occ->depths[15 * 16 + 8] < 5);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                              main                                 *
+ *                                                                   *
+ *********************************************************************/
+
+int
+main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(depth_only_tri);
+    RUN_TEST(sloped_depths);
+    RUN_TEST(wall_hides);
+    RUN_TEST(partial_wall);
+    RUN_TEST(silhouette_gap);
+    RUN_TEST(sloped_wall);
+    RUN_TEST(slot);
+    RUN_TEST(near_plane);
+    return UNITY_END();
+}
@@ -0,0 +1,262 @@
+
+#include "unity.h"
+#include "post.c"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*********************************************************************
+ *                                                                   *
+ *                          unity helpers                            *
+ *                                                                   *
+ *********************************************************************/
+
+#define W 67    /* four vector steps and a tail */
+#define H 40
+
+uint32_t g_colors[W * H];
+struct sr_framebuffer g_fbuf;
+
+void
+setUp()
+{
+    memset(g_colors, 0, sizeof(g_colors));
+    g_fbuf = (struct sr_framebuffer){
+        .width = W,
+        .height = H,
+        .colors = g_colors
+    };
+}
+
+void
+tearDown()
+{
+}
+
+/* how much of the pixel at 'x', 'y' lies below the line y = x / 4 + 5 */
+static float
+coverage(int x, int y)
+{
+    int inside = 0;
+    for (int j = 0; j < 16; j++) {
+        for (int i = 0; i < 16; i++) {
+            float sx = x + (i + 0.5f) / 16;
+            float sy = y + (j + 0.5f) / 16;
+            inside += sy > sx / 4 + 5;
+        }
+    }
+    return inside / 256.0f;
+}
+
+/* a shallow edge drawn without anti-aliasing, white below */
+static void
+staircase()
+{
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++)
+            g_colors[y * W + x] = coverage(x, y) >= 0.5f ?
+                                  0xffffffff : 0xff000000;
+}
+
+/* summed difference of the green channel from the true coverage */
+static float
+coverage_error()
+{
+    float error = 0;
+    for (int y = 1; y < H - 1; y++)
+        for (int x = 1; x < W - 1; x++)
+            error += fabsf((g_colors[y * W + x] >> 8 & 0xff) / 255.0f -
+                           coverage(x, y));
+    return error;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                               luma                                *
+ *                                                                   *
+ *********************************************************************/
+
+/************
+ * luma_row *
+ ************/
+
+/* the vector path agrees with a pixel at a time */
+
+void
+luma_row_matches()
+{
+    uint32_t colors[37];
+    uint8_t luma[37];
+
+    for (int i = 0; i < 37; i++)
+        colors[i] = 0xff000000 | (uint32_t)(i * 2654435761u >> 8);
+    colors[0] = 0xffffffff;
+    colors[1] = 0xff000000;
+
+    luma_row(luma, colors, 37);
+
+    for (int i = 0; i < 37; i++)
+        TEST_ASSERT_EQUAL_UINT8(luma_of(colors[i]), luma[i]);
+    TEST_ASSERT_EQUAL_UINT8(255, luma[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, luma[1]);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                               edges                               *
+ *                                                                   *
+ *********************************************************************/
+
+/*************
+ * edge_mask *
+ *************/
+
+/* sixteen pixels at once give what each would alone */
+
+void
+edge_mask_matches()
+{
+    uint8_t luma[W * 3];
+    for (int i = 0; i < W * 3; i++)
+        luma[i] = (i * 2654435761u >> 13) & (i % 5 ? 0x3f : 0xff);
+
+    for (int x = 1; x + 16 <= W - 1; x++) {
+        uint32_t mask = edge_mask(luma, W, x, 1);
+        for (int i = 0; i < 16; i++)
+            TEST_ASSERT_EQUAL_INT(is_edge(luma, W, x + i, 1),
+                                  (mask >> i) & 1);
+    }
+}
+
+/*********
+ * blend *
+ *********/
+
+void
+blend_channels()
+{
+    TEST_ASSERT_EQUAL_HEX32(0xff000000, blend(0xff000000, 0xffffffff, 0));
+    TEST_ASSERT_EQUAL_HEX32(0xff7f7f7f, blend(0xff000000, 0xffffffff, 128));
+    TEST_ASSERT_EQUAL_HEX32(0x80402010, blend(0x80402010, 0x80402010, 200));
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                               fxaa                                *
+ *                                                                   *
+ *********************************************************************/
+
+/**************
+ * flat_frame *
+ **************/
+
+/* nothing changes without an edge, low contrast included */
+
+void
+flat_frame()
+{
+    for (int i = 0; i < W * H; i++)
+        g_colors[i] = (i / W) % 2 ? 0xff080808 : 0xff000000;
+
+    uint32_t before[W * H];
+    memcpy(before, g_colors, sizeof(before));
+
+    TEST_ASSERT_EQUAL_INT(1, sr_fxaa(&g_fbuf));
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(before, g_colors, W * H);
+}
+
+/******************
+ * staircase_edge *
+ ******************/
+
+/**
+ * the steps of a shallow edge blend toward the coverage of each
+ * pixel, while the pixels away from it and the border stay put
+ */
+
+void
+staircase_edge()
+{
+    staircase();
+    float before = coverage_error();
+
+    TEST_ASSERT_EQUAL_INT(1, sr_fxaa(&g_fbuf));
+    TEST_ASSERT_TRUE(coverage_error() < 0.5f * before);
+
+    TEST_ASSERT_EQUAL_HEX32(0xff000000, g_colors[1 * W + 30]);
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, g_colors[38 * W + 30]);
+    for (int x = 0; x < W; x++)
+        TEST_ASSERT_EQUAL_HEX32(0xff000000, g_colors[x]);
+
+    /* alpha is blended as a channel like the rest */
+    for (int i = 0; i < W * H; i++)
+        TEST_ASSERT_EQUAL_HEX32(0xff000000, g_colors[i] & 0xff000000);
+}
+
+/**************
+ * many_bands *
+ **************/
+
+/* a frame split between threads matches the same frame in one band */
+
+void
+many_bands()
+{
+    enum { TALL = MIN_BAND_ROWS * 4 };
+    uint32_t* colors = malloc(W * TALL * sizeof(uint32_t));
+    uint32_t* single = malloc(W * TALL * sizeof(uint32_t));
+    uint32_t* src = malloc(W * TALL * sizeof(uint32_t));
+    uint8_t* luma = malloc(W * TALL);
+
+    for (int y = 0; y < TALL; y++)
+        for (int x = 0; x < W; x++)
+            colors[y * W + x] = (x - 33) * (x - 33) + (y - 120) * (y - 120) <
+                                100 * 100 ? 0xffffffff : 0xff204080;
+    memcpy(single, colors, W * TALL * sizeof(uint32_t));
+
+    struct sr_framebuffer fbuf = {.width = W, .height = TALL,
+                                  .colors = colors};
+    struct band bands[4];
+    for (int i = 0; i < 4; i++) {
+        bands[i] = (struct band){
+            .fbuf = &fbuf,
+            .src = src,
+            .luma = luma,
+            .y0 = TALL * i / 4,
+            .y1 = TALL * (i + 1) / 4
+        };
+    }
+    run_bands(luma_pass, bands, 4);
+    run_bands(edge_pass, bands, 4);
+
+    struct sr_framebuffer one = {.width = W, .height = TALL,
+                                 .colors = single};
+    TEST_ASSERT_EQUAL_INT(1, sr_fxaa(&one));
+
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(single, colors, W * TALL);
+
+    free(colors);
+    free(single);
+    free(src);
+    free(luma);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                              main                                 *
+ *                                                                   *
+ *********************************************************************/
+
+int
+main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(luma_row_matches);
+    RUN_TEST(edge_mask_matches);
+    RUN_TEST(blend_channels);
+    RUN_TEST(flat_frame);
+    RUN_TEST(staircase_edge);
+    RUN_TEST(many_bands);
+    return UNITY_END();
+}
@@ -84,6 +84,14 @@ vs_transform(float* out, float* in, void* uniform)
 }
 
 
+/* shifts each instance a fifth of the screen further right */
+static void
+inst_shift(void* uniform, int instance_id)
+{
+    struct mat4* m = (struct mat4*)uniform;
+    m->e03 = 0.2 * instance_id;
+}
+
 static void
 fs_basic(uint32_t* out, float* in, void* uniform)
 {
@@ -245,6 +253,165 @@ three_triangles()
     TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_colors, 10 * 10);
 }
 
+/**************
+ * multi_draw *
+ **************/
+
+/* the three triangles again, as three records over one index range */
+void 
+multi_draw() 
+{
+    float pts_in[5 * 3 * 3] = {
+        0, 0, 0, 10, 1,
+        5, 0, 0, 10, 1,
+        0, 5, 0, 10, 1,
+
+        0, 6, 0, 10, 2,
+        3, 6, 0, 10, 2,
+        3, 10, 0, 10, 2,
+
+        -5, -9, 0, 10, 3,
+        4, 0, 0, 10, 3,
+        -9, 4, 0, 10, 3
+    };
+
+    g_pipe.pts_in = pts_in;
+    g_pipe.n_pts = 9;
+
+    int indices[6] = {0, 1, 2, 2, 0, 1};
+    struct sr_draw draws[3] = {
+        { .first_index = 0, .n_indices = 3, .base_vertex = 0 },
+        { .first_index = 0, .n_indices = 3, .base_vertex = 3 },
+        { .first_index = 3, .n_indices = 3, .base_vertex = 6 }
+    };
+    sr_render_multi(&g_pipe, indices, draws, 3, SR_TRIANGLE_LIST);
+    
+    uint32_t target_colors[10 * 10] = {
+        0, 0, 0, 0, 0, 0, 2, 0, 0, 0,
+        0, 0, 0, 0, 0, 2, 2, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 3, 0, 0, 0, 1, 0, 0, 0, 0,
+        0, 3, 3, 3, 3, 1, 1, 0, 0, 0,
+        0, 3, 3, 3, 3, 3, 0, 0, 0, 0,
+        0, 0, 3, 3, 3, 0, 0, 0, 0, 0,
+        0, 0, 3, 3, 0, 0, 0, 0, 0, 0,
+        0, 0, 3, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    };
+
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_colors, 10 * 10);
+}
+
+/********************
+ * separate_streams *
+ ********************/
+
+/* the same triangles drawn from strided streams match the interleaved ones */
+void
+separate_streams() 
+{
+    float pts_in[5 * 3 * 2] = {
+        0, 0, 0, 10, 1,
+        5, 0, 0, 10, 1,
+        0, 5, 0, 10, 1,
+
+        0, 6, 0, 10, 2,
+        3, 6, 0, 10, 2,
+        3, 10, 0, 10, 2
+    };
+
+    float pos[4 * 6] = {
+        0, 0, 0, 10,
+        5, 0, 0, 10,
+        0, 5, 0, 10,
+        0, 6, 0, 10,
+        3, 6, 0, 10,
+        3, 10, 0, 10
+    };
+
+    float color[2 * 6] = {     /* every other float is padding */
+        1, -1,
+        1, -1,
+        1, -1,
+        2, -1,
+        2, -1,
+        2, -1
+    };
+
+    int indices[6] = {0, 1, 2, 3, 4, 5};
+
+    g_pipe.pts_in = pts_in;
+    g_pipe.n_pts = 6;
+    sr_render(&g_pipe, indices, 6, SR_TRIANGLE_LIST);
+
+    uint32_t target_colors[10 * 10];
+    memcpy(target_colors, g_colors, sizeof(target_colors));
+    memset(g_colors, 0, sizeof(g_colors));
+    for (int i = 0; i < 10 * 10; i++)
+        g_depths[i] = 100000;
+
+    struct sr_stream streams[2] = {
+        { .data = pos, .n_attr = 4, .stride = 0 },
+        { .data = color, .n_attr = 1, .stride = 2 }
+    };
+
+    g_pipe.pts_in = NULL;
+    g_pipe.streams = streams;
+    g_pipe.n_streams = 2;
+    sr_render(&g_pipe, indices, 6, SR_TRIANGLE_LIST);
+    g_pipe.streams = NULL;
+    g_pipe.n_streams = 0;
+
+    TEST_ASSERT_EQUAL_UINT32(1, target_colors[4 * 10 + 5]);
+    TEST_ASSERT_EQUAL_UINT32(2, target_colors[0 * 10 + 6]);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_colors, 10 * 10);
+}
+
+/*****************
+ * fetch_formats *
+ *****************/
+
+/* half, snorm16 and unorm16 streams decode into one float point */
+void
+fetch_formats() 
+{
+    uint16_t half[2 * 4] = {
+        0, 0, 0, 0,
+        0x3c00, 0xc100, 0x0400, 0x0001     /* 1, -2.5, 2^-14, 2^-24 */
+    };
+    int16_t snorm[2 * 3] = {
+        0, 0, 0,
+        32767, -32768, 0
+    };
+    uint16_t unorm[2 * 3] = {      /* last component is padding */
+        0, 0, 0,
+        65535, 0, 1234
+    };
+
+    struct sr_stream streams[3] = {
+        { .data = half, .format = SR_FORMAT_F16, .n_attr = 4 },
+        { .data = snorm, .format = SR_FORMAT_SNORM16, .n_attr = 3 },
+        { .data = unorm, .format = SR_FORMAT_UNORM16, 
+          .n_attr = 2, .stride = 3 }
+    };
+
+    struct sr_pipeline pipe = {
+        .streams = streams,
+        .n_streams = 3
+    };
+
+    float ans[9] = {
+        1, -2.5, 1.0 / 16384, 1.0 / 16777216,
+        1, -1, 0,
+        1, 0
+    };
+
+    float out[SR_MAX_ATTRIBUTE_COUNT];
+    float* pt = fetch_vertex(&pipe, out, 1);
+
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(ans, pt, 9);
+}
+
 
 /****************
  * triangle_fan *
@@ -285,6 +452,176 @@ triangle_fan()
     TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_colors, 10 * 10);
 }
 
+/******************
+ * triangle_strip *
+ ******************/
+
+/** 
+ * a strip with alternating winding and a restart draws the same 
+ * image as the equivalent list, with no triangle culled as back facing 
+ */
+void
+triangle_strip()
+{
+    float pts_in[5 * 7] = {
+        -8, 0, 0, 10, 1,
+        -8, -8, 0, 10, 1,
+        0, 0, 0, 10, 1,
+        0, -8, 0, 10, 1,
+        8, 0, 0, 10, 1,
+        8, -9, 0, 10, 2,
+        9, -2, 0, 10, 2
+    };
+
+    g_pipe.pts_in = pts_in;
+    g_pipe.n_pts = 7;
+
+    int list[12] = {
+        0, 1, 2,
+        2, 1, 3,
+        2, 3, 4,
+        3, 5, 6
+    };
+    sr_render(&g_pipe, list, 12, SR_TRIANGLE_LIST);
+
+    uint32_t target_colors[10 * 10];
+    memcpy(target_colors, g_colors, sizeof(target_colors));
+    setUp();
+
+    struct sr_stats stats = {0};
+    g_pipe.stats = &stats;
+
+    int strip[9] = {0, 1, 2, 3, 4, SR_PRIMITIVE_RESTART, 3, 5, 6};
+    sr_render(&g_pipe, strip, 9, SR_TRIANGLE_STRIP);
+    g_pipe.stats = NULL;
+
+    TEST_ASSERT_EQUAL_INT(4, stats.n_prims);
+    TEST_ASSERT_EQUAL_INT(0, stats.n_backface_culled);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_colors, 10 * 10);
+}
+
+/************************
+ * triangle_fan_restart *
+ ************************/
+
+/* two fans split by a restart share nothing but the index buffer */
+void
+triangle_fan_restart()
+{
+    float pts_in[5 * 7] = {
+        0, 0, 0, 10, 1,
+        5, 0, 0, 10, 1,
+        0, 5, 0, 10, 1,
+        -2.5, 9, 0, 10, 1,
+        -5, -7, 0, 10, 2,
+        -2, -9, 0, 10, 2,
+        -1, -7, 0, 10, 2
+    };
+
+    g_pipe.pts_in = pts_in;
+    g_pipe.n_pts = 7;
+
+    int list[9] = {0, 1, 2, 0, 2, 3, 4, 5, 6};
+    sr_render(&g_pipe, list, 9, SR_TRIANGLE_LIST);
+
+    uint32_t target_colors[10 * 10];
+    memcpy(target_colors, g_colors, sizeof(target_colors));
+    setUp();
+
+    int fan[8] = {0, 1, 2, 3, SR_PRIMITIVE_RESTART, 4, 5, 6};
+    sr_render(&g_pipe, fan, 8, SR_TRIANGLE_FAN);
+
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_colors, 10 * 10);
+}
+
+/**************
+ * line_strip *
+ **************/
+
+/** 
+ * a strip of two segments, the first clipped against the left plane,
+ * the second blending its color attribute from 1 to 2 
+ */
+void
+line_strip()
+{
+    float pts_in[5 * 3] = {
+        -20, 0, 0, 10, 1,
+        5, 0, 0, 10, 1,
+        5, -8, 0, 10, 2
+    };
+
+    g_pipe.pts_in = pts_in;
+    g_pipe.n_pts = 3;
+
+    int indices[3] = {0, 1, 2};
+    sr_render(&g_pipe, indices, 3, SR_LINE_STRIP);
+
+    uint32_t target_colors[10 * 10] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 1, 1, 1, 1, 1, 1, 1, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 1, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 2, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 2, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_colors, 10 * 10);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             culling                               *
+ *                                                                   *
+ *********************************************************************/
+
+/*****************
+ * culled_stages *
+ *****************/
+
+/**
+ * back facing and zero area triangles are dropped before clipping, 
+ * and each stage counts what it culled
+ */
+void
+culled_stages()
+{
+    float pts_in[5 * 7] = {
+        0, 0, 0, 10, 1,
+        5, 0, 0, 10, 1,
+        0, 5, 0, 10, 1,
+        10, 10, 0, 10, 1,    /* collinear with the first point */
+        -20, 0, 0, 10, 1,    /* beyond the left plane */
+        -30, 0, 0, 10, 1,
+        -20, 5, 0, 10, 1
+    };
+
+    g_pipe.pts_in = pts_in;
+    g_pipe.n_pts = 7;
+
+    struct sr_stats stats = {0};
+    g_pipe.stats = &stats;
+
+    int indices[12] = {
+        0, 1, 2,    /* drawn */
+        0, 2, 1,    /* back facing */
+        0, 3, 3,    /* degenerate */
+        4, 5, 6     /* outside */
+    };
+    sr_render(&g_pipe, indices, 12, SR_TRIANGLE_LIST);
+    g_pipe.stats = NULL;
+
+    TEST_ASSERT_EQUAL_INT(4, stats.n_prims);
+    TEST_ASSERT_EQUAL_INT(1, stats.n_frustum_culled);
+    TEST_ASSERT_EQUAL_INT(1, stats.n_degenerate_culled);
+    TEST_ASSERT_EQUAL_INT(1, stats.n_backface_culled);
+    TEST_ASSERT_EQUAL_INT(0, stats.n_winding_culled);
+}
+
 /*********************************************************************
  *                                                                   *
  *                           perspective                             *
@@ -561,6 +898,171 @@ clip_three_triangles()
     TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_colors, 10 * 10);
 }
 
+/*******************
+ * instanced_point *
+ *******************/
+
+/* one point drawn three times, moved by the per instance hook */
+void
+instanced_point()
+{
+    struct mat4 shift = {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1
+    };
+
+    g_pipe.uniform = (void*)(&shift);
+    g_pipe.vs = vs_transform;
+
+    float pts_in[5] = {0, 0, 0, 1, 1};
+    g_pipe.pts_in = pts_in;
+    g_pipe.n_pts = 1;
+
+    int indices[1] = {0};
+    sr_render_instanced(&g_pipe, indices, 1, SR_POINT_LIST, 3, inst_shift);
+
+    g_pipe.uniform = &g_uniform;
+    g_pipe.vs = vs_basic;
+
+    uint32_t target_colors[10 * 10] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 1, 1, 1, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, g_colors, 10 * 10);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                           multisampling                           *
+ *                                                                   *
+ *********************************************************************/
+
+/*******************
+ * resolve_average *
+ *******************/
+
+/* each channel averages on its own, depth keeps the nearest sample */
+
+void
+resolve_average()
+{
+    uint32_t sample_colors[2 * 4] = {
+        0xffffffff, 0xffffffff, 0, 0,
+        0xff0000ff, 0xff0000ff, 0xff000001, 0xff000000
+    };
+    float sample_depths[2 * 4] = {
+        3, 2, 5, 4,
+        1, 1, 1, 1
+    };
+
+    uint32_t colors[2];
+    float depths[2];
+    struct sr_framebuffer fbuf = {
+        .colors = colors,
+        .depths = depths,
+        .width = 2,
+        .height = 1,
+        .n_samples = 4,
+        .sample_colors = sample_colors,
+        .sample_depths = sample_depths
+    };
+
+    sr_resolve(&fbuf);
+
+    uint32_t target_colors[2] = {0x80808080, 0xff000080};
+    float target_depths[2] = {2, 1};
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(target_colors, colors, 2);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(target_depths, depths, 2);
+}
+
+/*********************
+ * resolve_bad_count *
+ *********************/
+
+/* a count other than 2, 4 or 8 leaves the framebuffer alone */
+
+void
+resolve_bad_count()
+{
+    uint32_t sample_colors[16] = {0};
+    float sample_depths[16] = {0};
+    uint32_t colors[1] = {0x12345678};
+    float depths[1] = {7};
+    struct sr_framebuffer fbuf = {
+        .colors = colors,
+        .depths = depths,
+        .width = 1,
+        .height = 1,
+        .sample_colors = sample_colors,
+        .sample_depths = sample_depths
+    };
+
+    int counts[3] = {3, 6, 16};
+    for (int i = 0; i < 3; i++) {
+        fbuf.n_samples = counts[i];
+        sr_resolve(&fbuf);
+        TEST_ASSERT_EQUAL_HEX32(0x12345678, colors[0]);
+        TEST_ASSERT_EQUAL_FLOAT(7, depths[0]);
+    }
+}
+
+/*****************
+ * msaa_triangle *
+ *****************/
+
+/**
+ * through the whole pipeline with 4 samples, a color of 4 resolves 
+ * to the number of samples covered, so edge pixels land in between
+ */
+
+void
+msaa_triangle()
+{
+    uint32_t sample_colors[10 * 10 * 4] = {0};
+    float sample_depths[10 * 10 * 4];
+    for (int i = 0; i < 10 * 10 * 4; i++)
+        sample_depths[i] = 100000;
+
+    g_fbuf.n_samples = 4;
+    g_fbuf.sample_colors = sample_colors;
+    g_fbuf.sample_depths = sample_depths;
+
+    float pts_in[3 * 5] = {
+        -0.9, -0.7, 0, 1, 4,
+        0.8, -0.9, 0, 1, 4,
+        0.1, 0.85, 0, 1, 4
+    };
+    g_pipe.pts_in = pts_in;
+    g_pipe.n_pts = 3;
+    int indices[3] = {0, 1, 2};
+    sr_render(&g_pipe, indices, 3, SR_TRIANGLE_LIST);
+
+    sr_resolve(&g_fbuf);
+    g_fbuf.n_samples = 0;
+
+    int seen[5] = {0};
+    for (int i = 0; i < 10 * 10; i++) {
+        int covered = 0;
+        for (int s = 0; s < 4; s++)
+            covered += sample_colors[4 * i + s] == 4;
+        TEST_ASSERT_EQUAL_UINT32(covered, g_colors[i]);
+        seen[covered] = 1;
+    }
+
+    TEST_ASSERT_TRUE(seen[1] && seen[2] && seen[3] && seen[4]);
+}
+
 /*********************************************************************
  *                                                                   *
  *                             main                                  *
@@ -575,13 +1077,24 @@ main()
     RUN_TEST(three_points);
     RUN_TEST(one_triangle);
     RUN_TEST(triangle_fan);
+    RUN_TEST(triangle_strip);
+    RUN_TEST(triangle_fan_restart);
+    RUN_TEST(line_strip);
     RUN_TEST(flat_depth);
     RUN_TEST(near_depth);
     RUN_TEST(far_depth);
     RUN_TEST(three_triangles);
+    RUN_TEST(multi_draw);
+    RUN_TEST(separate_streams);
+    RUN_TEST(fetch_formats);
+    RUN_TEST(culled_stages);
     RUN_TEST(clip_three_triangles);
     RUN_TEST(projection_matrix);
     RUN_TEST(another_projection_test);
+    RUN_TEST(instanced_point);
+    RUN_TEST(resolve_average);
+    RUN_TEST(resolve_bad_count);
+    RUN_TEST(msaa_triangle);
     return UNITY_END();
 }
 
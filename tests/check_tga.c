@@ -0,0 +1,173 @@
+
+#include "unity.h"
+#include "tga.c"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*********************************************************************
+ *                                                                   *
+ *                          unity helpers                            *
+ *                                                                   *
+ *********************************************************************/
+
+struct sr_texture* g_texture;
+
+void
+setUp()
+{
+    g_texture = NULL;
+}
+
+void
+tearDown()
+{
+    sr_texture_free(g_texture);
+}
+
+/* fills in an 18 byte tga header */
+static void
+header(uint8_t* h, int type, int width, int height, int bits, int desc)
+{
+    memset(h, 0, TGA_HEADER_SIZE);
+    h[2] = type;
+    h[12] = width & 0xff;
+    h[13] = width >> 8;
+    h[14] = height & 0xff;
+    h[15] = height >> 8;
+    h[16] = bits;
+    h[17] = desc;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                               raw                                 *
+ *                                                                   *
+ *********************************************************************/
+
+/**************
+ * raw_bottom *
+ **************/
+
+/* 24 bit bottom up rows, wide enough for the vector path and a tail */
+
+void
+raw_bottom()
+{
+    uint8_t data[TGA_HEADER_SIZE + 7 * 2 * 3];
+    header(data, TGA_RAW, 7, 2, 24, 0);
+
+    uint8_t* px = data + TGA_HEADER_SIZE;
+    for (int i = 0; i < 14; i++) {
+        px[3 * i] = i;              /* b */
+        px[3 * i + 1] = 0x10 + i;   /* g */
+        px[3 * i + 2] = 0x20 + i;   /* r */
+    }
+
+    g_texture = decode_tga(data, sizeof(data));
+    TEST_ASSERT_NOT_NULL(g_texture);
+    TEST_ASSERT_EQUAL_INT(7, g_texture->width);
+    TEST_ASSERT_EQUAL_INT(2, g_texture->height);
+
+    /* the second row in the file is the top one */
+    uint32_t ans[14];
+    for (int i = 0; i < 14; i++) {
+        int j = (i + 7) % 14;
+        ans[i] = 0xff000000 | (0x20 + j) << 16 | (0x10 + j) << 8 | j;
+    }
+
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(ans, g_texture->colors, 14);
+}
+
+/*************
+ * raw_alpha *
+ *************/
+
+/* 32 bit top down keeps alpha */
+
+void
+raw_alpha()
+{
+    uint8_t data[TGA_HEADER_SIZE + 2 * 4] = {0};
+    header(data, TGA_RAW, 2, 1, 32, TGA_TOP_DOWN);
+
+    uint8_t px[8] = {0x01, 0x02, 0x03, 0x80, 0x11, 0x12, 0x13, 0x00};
+    memcpy(data + TGA_HEADER_SIZE, px, 8);
+
+    g_texture = decode_tga(data, sizeof(data));
+    TEST_ASSERT_NOT_NULL(g_texture);
+
+    uint32_t ans[2] = {0x80030201, 0x00131211};
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(ans, g_texture->colors, 2);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                           run length                              *
+ *                                                                   *
+ *********************************************************************/
+
+/*************
+ * rle_mixed *
+ *************/
+
+/* a run crossing rows then a raw packet, bottom up and right to left */
+
+void
+rle_mixed()
+{
+    uint8_t data[TGA_HEADER_SIZE + 16];
+    header(data, TGA_RLE, 2, 2, 24, TGA_RIGHT_TO_LEFT);
+
+    uint8_t packets[] = {
+        0x82, 0x00, 0x00, 0xff,     /* run of 3 red */
+        0x00, 0xff, 0x00, 0x00      /* 1 raw blue */
+    };
+    memcpy(data + TGA_HEADER_SIZE, packets, sizeof(packets));
+
+    g_texture = decode_tga(data, TGA_HEADER_SIZE + sizeof(packets));
+    TEST_ASSERT_NOT_NULL(g_texture);
+
+    uint32_t ans[4] = {
+        0xff0000ff, 0xffff0000,
+        0xffff0000, 0xffff0000
+    };
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(ans, g_texture->colors, 4);
+}
+
+/*************
+ * truncated *
+ *************/
+
+/* data that ends before the image does is rejected */
+
+void
+truncated()
+{
+    uint8_t data[TGA_HEADER_SIZE + 4];
+    header(data, TGA_RLE, 4, 4, 24, 0);
+    uint8_t packets[4] = {0x83, 1, 2, 3};    /* 4 of 16 pixels */
+    memcpy(data + TGA_HEADER_SIZE, packets, 4);
+
+    TEST_ASSERT_NULL(decode_tga(data, sizeof(data)));
+
+    header(data, TGA_RAW, 4, 4, 24, 0);
+    TEST_ASSERT_NULL(decode_tga(data, sizeof(data)));
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                              main                                 *
+ *                                                                   *
+ *********************************************************************/
+
+int
+main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(raw_bottom);
+    RUN_TEST(raw_alpha);
+    RUN_TEST(rle_mixed);
+    RUN_TEST(truncated);
+    return UNITY_END();
+}
@@ -0,0 +1,326 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "sr.h"
+
+/**
+ * tga.c
+ * --------
+ * loads truecolor .tga images, raw or run length encoded, into
+ * the top down 32 bit argb texels sample_texture reads
+ *
+ * tga stores pixels as b, g, r(, a) bytes, which on a little
+ * endian machine already read as argb words, so 32 bit rows are
+ * copied as they are and 24 bit rows only gain an alpha byte
+ *
+ */
+
+#define TGA_HEADER_SIZE 18
+
+#define TGA_RAW 2
+#define TGA_RLE 10
+
+#define TGA_RIGHT_TO_LEFT (1 << 4)      /* image descriptor bits */
+#define TGA_TOP_DOWN (1 << 5)
+
+/*********************************************************************
+ *                                                                   *
+ *                           conversion                              *
+ *                                                                   *
+ *********************************************************************/
+
+/***************
+ * convert_bgr *
+ ***************/
+
+/* turns 'n' packed b, g, r pixels into opaque argb */
+static void
+convert_bgr(uint32_t* dest, const uint8_t* src, int n)
+{
+    int i = 0;
+
+#ifdef __SSSE3__
+    /* 4 pixels per 16 byte load, stop while a full load stays in bounds */
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                                          6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+    for (; i + 6 <= n; i += 4) {
+        __m128i bgr = _mm_loadu_si128((const __m128i*)(src + 3 * i));
+        __m128i argb = _mm_or_si128(_mm_shuffle_epi8(bgr, shuffle), alpha);
+        _mm_storeu_si128((__m128i*)(dest + i), argb);
+    }
+#endif
+
+    for (; i < n; i++) {
+        const uint8_t* p = src + 3 * i;
+        dest[i] = 0xff000000 | p[2] << 16 | p[1] << 8 | p[0];
+    }
+}
+
+/****************
+ * convert_bgra *
+ ****************/
+
+/* turns 'n' packed b, g, r, a pixels into argb */
+static void
+convert_bgra(uint32_t* dest, const uint8_t* src, int n)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(dest, src, 4 * (size_t)n);
+#else
+    for (int i = 0; i < n; i++) {
+        const uint8_t* p = src + 4 * i;
+        dest[i] = (uint32_t)p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0];
+    }
+#endif
+}
+
+/***********
+ * convert *
+ ***********/
+
+static inline void
+convert(uint32_t* dest, const uint8_t* src, int n, int bytes)
+{
+    if (bytes == 3)
+        convert_bgr(dest, src, n);
+    else
+        convert_bgra(dest, src, n);
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                             decoding                              *
+ *                                                                   *
+ *********************************************************************/
+
+/**************
+ * decode_rle *
+ **************/
+
+/**
+ * expands run length packets into 'n' pixels in file order, runs
+ * may cross rows, returns 0 if the data ends early
+ */
+static int
+decode_rle(uint32_t* dest, const uint8_t* src, const uint8_t* end,
+           int n, int bytes)
+{
+    int i = 0;
+
+    while (i < n) {
+        if (src >= end)
+            return 0;
+
+        int count = (*src & 0x7f) + 1;
+        int run = *src & 0x80;
+        src++;
+
+        if (count > n - i)
+            count = n - i;
+
+        if (run) {
+            if (end - src < bytes)
+                return 0;
+            uint32_t px;
+            convert(&px, src, 1, bytes);
+            for (int j = 0; j < count; j++)
+                dest[i + j] = px;
+            src += bytes;
+        } else {
+            if (end - src < (ptrdiff_t)count * bytes)
+                return 0;
+            convert(dest + i, src, count, bytes);
+            src += count * bytes;
+        }
+
+        i += count;
+    }
+
+    return 1;
+}
+
+/*************
+ * flip_rows *
+ *************/
+
+/* turns a bottom up image top down in place */
+static void
+flip_rows(uint32_t* colors, int width, int height)
+{
+    for (int y = 0; y < height / 2; y++) {
+        uint32_t* a = colors + y * width;
+        uint32_t* b = colors + (height - 1 - y) * width;
+        for (int x = 0; x < width; x++) {
+            uint32_t tmp = a[x];
+            a[x] = b[x];
+            b[x] = tmp;
+        }
+    }
+}
+
+/*************
+ * flip_cols *
+ *************/
+
+/* turns a right to left image left to right in place */
+static void
+flip_cols(uint32_t* colors, int width, int height)
+{
+    for (int y = 0; y < height; y++) {
+        uint32_t* row = colors + y * width;
+        for (int x = 0; x < width / 2; x++) {
+            uint32_t tmp = row[x];
+            row[x] = row[width - 1 - x];
+            row[width - 1 - x] = tmp;
+        }
+    }
+}
+
+/**************
+ * decode_tga *
+ **************/
+
+/* decodes a whole tga held in memory, returns null if unsupported */
+static struct sr_texture*
+decode_tga(const uint8_t* data, size_t size)
+{
+    if (size < TGA_HEADER_SIZE)
+        return 0;
+
+    int id_length = data[0];
+    int cmap_type = data[1];
+    int image_type = data[2];
+    int cmap_length = data[5] | data[6] << 8;
+    int cmap_bits = data[7];
+    int width = data[12] | data[13] << 8;
+    int height = data[14] | data[15] << 8;
+    int bits = data[16];
+    int descriptor = data[17];
+
+    if (image_type != TGA_RAW && image_type != TGA_RLE)
+        return 0;
+    if (bits != 24 && bits != 32)
+        return 0;
+    if (width == 0 || height == 0)
+        return 0;
+
+    int bytes = bits / 8;
+    int n = width * height;
+
+    /* a color map may be present even when unused */
+    size_t offset = TGA_HEADER_SIZE + id_length;
+    if (cmap_type)
+        offset += (size_t)cmap_length * ((cmap_bits + 7) / 8);
+    if (offset > size)
+        return 0;
+
+    const uint8_t* src = data + offset;
+    const uint8_t* end = data + size;
+
+    struct sr_texture* texture = malloc(sizeof(struct sr_texture));
+    uint32_t* colors = malloc((size_t)n * sizeof(uint32_t));
+    if (!texture || !colors) {
+        free(texture);
+        free(colors);
+        return 0;
+    }
+
+    int ok = 1;
+    int top_down = descriptor & TGA_TOP_DOWN;
+
+    if (image_type == TGA_RLE) {
+        ok = decode_rle(colors, src, end, n, bytes);
+        if (ok && !top_down)
+            flip_rows(colors, width, height);
+    } else if ((size_t)(end - src) < (size_t)n * bytes) {
+        ok = 0;
+    } else {
+        /* rows go straight to where they belong */
+        for (int y = 0; y < height; y++) {
+            int row = top_down ? y : height - 1 - y;
+            convert(colors + (size_t)row * width,
+                    src + (size_t)y * width * bytes, width, bytes);
+        }
+    }
+
+    if (!ok) {
+        free(texture);
+        free(colors);
+        return 0;
+    }
+
+    if (descriptor & TGA_RIGHT_TO_LEFT)
+        flip_cols(colors, width, height);
+
+    texture->colors = colors;
+    texture->width = width;
+    texture->height = height;
+
+    return texture;
+}
+
+/*********************************************************************
+ *                                                                   *
+ *                            interface                              *
+ *                                                                   *
+ *********************************************************************/
+
+/***************
+ * sr_load_tga *
+ ***************/
+
+/**
+ * loads a 24 or 32 bit truecolor tga, raw or run length encoded,
+ * returns null if the file can't be read or isn't supported
+ */
+extern struct sr_texture*
+sr_load_tga(char* file)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = st.st_size;
+    const uint8_t* data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+
+    struct sr_texture* texture = decode_tga(data, size);
+
+    munmap((void*)data, size);
+    return texture;
+}
+
+/*******************
+ * sr_texture_free *
+ *******************/
+
+/* frees a texture from sr_load_tga */
+extern void
+sr_texture_free(struct sr_texture* texture)
+{
+    if (!texture)
+        return;
+    free(texture->colors);
+    free(texture);
+}